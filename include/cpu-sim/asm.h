@@ -0,0 +1,45 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	asm.h
+ *	Descrioption:	assembler of the Educational CPU instruction set
+ */
+
+#ifndef	ASM_H
+#define	ASM_H
+
+#include	"cpuboard.h"
+
+/*=============================================================================
+ *   Assembly Source
+ *
+ *	[label:] [mnemonic [A,]B]	[; comment]
+ *
+ *	NOP HLT RCF SCF IN OUT JR
+ *	LD ST ADD ADC SUB SBC CMP AND OR EOR	A,B	A: ACC, IX
+ *		B: ACC, IX, d, [d], (d), [IX+d], (IX+d)  (ST: memory only)
+ *	SRA SLA SRL SLL RRA RLA RRL RLL		ACC
+ *	BA BVF BNZ BZ BZP BN BP BZN BNI BNO BNC BC BGE BLT BGT BLE  d
+ *	JAL					d
+ *
+ *	.text [addr]	go on at addr (default 00) of the program area
+ *	.data [addr]	go on at addr of the data area
+ *	.byte d[,d...]	data words
+ *
+ *   Mnemonics and registers are case-insensitive; ';', '#' and "//"
+ *   start comments.  A number is hexadecimal as everywhere in the
+ *   simulator ("1f", "0x1f", "1fh") and starts with a digit; d may add
+ *   and subtract numbers and labels (a label in the data area stands for
+ *   its address 1XX, of which (d) takes the low byte).
+ *
+ *   Words are encoded by looking the operation, register A and mode B up
+ *   in decode_table, so the assembler and the decoder cannot disagree;
+ *   init_decode_table() must have been called.  The program is assembled
+ *   whole before anything is written, so a source with errors loads
+ *   nothing.
+ *===========================================================================*/
+int	asm_assemble(const char *, Uword *, Uword *);
+int	asm_file(Cpub *, const char *);
+
+#endif	/* ASM_H */
@@ -0,0 +1,66 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	block.h
+ *	Descrioption:	basic-block translation cache (shared by the block
+ *			engine and the native code generator)
+ */
+
+#ifndef	BLOCK_H
+#define	BLOCK_H
+
+#include	<stddef.h>
+#include	"cpuboard.h"
+
+/*=============================================================================
+ *   Translation Cache
+ *
+ *   A block is the straight-line code from an entry address up to and
+ *   including the next Bbc/JAL/JR or instruction left to step(), cut after
+ *   BLOCK_MAX instructions.  Every instruction becomes one micro-op that
+ *   carries its handler and its operand word, so a block runs without
+ *   fetching or decoding.  Blocks are looked up by entry address.
+ *
+ *   Hot blocks may also have native code (cpu-jit.c); dropping a block
+ *   drops both forms.
+ *===========================================================================*/
+#define	BLOCK_MAX	32			/* instructions per block */
+#define	UOP_POOL	(128 * (BLOCK_MAX + 1))	/* micro-ops of all blocks */
+
+typedef struct uop {
+	const void	*op;	/* handler (run_block() label) */
+	Addr		ea;	/* effective or branch address */
+	Uword		inst;	/* instruction word */
+	Uword		imm;	/* operand word (immediate, displacement) */
+	Uword		pc;	/* address of the instruction */
+	Uword		next;	/* address of the following instruction */
+	Uword		slow;	/* executed by step() (always the last one) */
+} Uop;
+
+typedef struct block {
+	Uop	*uop;		/* NULL: not translated */
+	int	n;		/* instructions (a closing END is not counted) */
+	int	len;		/* words covered from the entry address */
+	int	heat;		/* entries counted for the native translation */
+} Block;
+
+struct blockcache {
+	Block	block[IMEMORY_SIZE];	/* indexed by entry address */
+	Uop	pool[UOP_POOL];
+	int	used;
+
+	void	*native[IMEMORY_SIZE];	/* native code of a block (or NULL) */
+	unsigned char	*code;		/* native code buffer (cpu-jit.c) */
+	size_t	code_used;
+	size_t	code_exit;		/* offset of its exit code */
+};
+
+struct blockcache	*block_cache(Cpub *);
+Block	*block_get(Cpub *, struct blockcache *, Uword);
+void	block_flush(Cpub *, struct blockcache *);
+void	block_sweep(Cpub *, struct blockcache *);
+void	block_free(Cpub *);
+void	jit_free(struct blockcache *);
+
+#endif	/* BLOCK_H */
@@ -6,6 +6,11 @@
  *	Descrioption:	resource definition of the educational computer board
  */
 
+#ifndef	CPUBOARD_H
+#define	CPUBOARD_H
+
+#include	<stddef.h>
+
 /*=============================================================================
  * Architectural Data Types
  *===========================================================================*/
@@ -24,22 +29,113 @@
  typedef struct iobuf {
 	 Bit	flag;
 	 Uword	buf;
+	 struct iodev	*dev;	/* file streamed through it (NULL: none) */
  } IOBuf;
  
+ /*
+  * Handshake of an IOBuf: OUT writes buf and then raises flag, IN reads
+  * buf and then lowers flag (release stores, acquire loads), so the two
+  * boards of a link may run on different threads without a lock.  A NULL
+  * IOBuf is an unconnected port: never ready, reads as 0.  With a device
+  * (iodev.c), IN refills the port from the file and OUT appends to it.
+  */
+ #if defined(__GNUC__)
+ #define	IOBufLoad(x)	__atomic_load_n(&(x),__ATOMIC_ACQUIRE)
+ #define	IOBufStore(x,v)	__atomic_store_n(&(x),(v),__ATOMIC_RELEASE)
+ #else	/* one thread only */
+ #define	IOBufLoad(x)	(x)
+ #define	IOBufStore(x,v)	((x) = (v))
+ #endif
+ 
+ static inline Bit
+ iobuf_ready(IOBuf *io)
+ {
+	 return io != NULL && IOBufLoad(io->flag);
+ }
+ 
+ Uword	iodev_take(IOBuf *);
+ void	iodev_put(IOBuf *, Uword);
+ 
+ static inline void
+ iobuf_put(IOBuf *io, Uword data)
+ {
+	 if( io->dev != NULL ) {
+		 iodev_put(io,data);
+		 return;
+	 }
+	 IOBufStore(io->buf,data);
+	 IOBufStore(io->flag,1);
+ }
+ 
+ static inline Uword
+ iobuf_take(IOBuf *io)
+ {
+	 Uword	data;
+ 
+	 if( io == NULL )
+		 return 0;
+	 if( io->dev != NULL )
+		 return iodev_take(io);
+	 data = IOBufLoad(io->buf);
+	 IOBufStore(io->flag,0);
+	 return data;
+ }
+ 
  typedef struct cpuboard {
 	 Uword	pc;
 	 Uword	acc;
 	 Uword	ix;
 	 Bit	cf, vf, nf, zf;
+	 Bit	flag_op;		/* pending flags (FLAGS_VALID: none) */
+	 Uword	flag_a, flag_b, flag_r;	/* ... operands and result */
 	 IOBuf	*ibuf;
 	 IOBuf	obuf;
 	 /*
 	  * [ add here the other CPU resources if necessary ]
 	  */
+	 struct tracering	*trace;	/* binary trace ring (NULL: off) */
+	 struct debugpoints	*debug;	/* cond. break/watch-points (NULL: none) */
+	 struct undolog	*undo;	/* undo log of step() (NULL: off) */
+	 struct profile	*prof;	/* profile of step() (NULL: off) */
+	 struct timing	*timing;	/* clock cycles of step() (NULL: off) */
+	 struct blockcache	*blocks;	/* translated blocks (cpu-block.c) */
+	 Uword	codemap[IMEMORY_SIZE/8];	/* words covered by translations */
+	 Uword	codedirty[IMEMORY_SIZE/8];	/* ... written since translated */
+	 Bit	codestale;		/* codedirty is not empty */
+	 Uword	brkmap[IMEMORY_SIZE/8];	/* PC break-points (1 bit/address) */
 	 Uword	mem[MEMORY_SIZE];	/* 0XX:Program, 1XX:Data */
  } Cpub;
  
  
+ /*
+  * Break/watch-point bitmap access (1 bit per address A)
+  */
+ #define	BrkTest(map,A)	((map)[(A) >> 3] & (1 << ((A) & 7)))
+ #define	BrkSet(map,A)	((map)[(A) >> 3] |= (Uword)(1 << ((A) & 7)))
+ #define	BrkClear(map,A)	((map)[(A) >> 3] &= (Uword)~(1 << ((A) & 7)))
+
+ /*
+  * Flags of ADD..EOR in step() are evaluated lazily from the operands and
+  * result of the last operation; FlagSync() brings cf, vf, nf, zf up to date
+  * (step() and run_step() return with them up to date)
+  */
+ #define	FLAGS_VALID	0
+ #define	FLAGS_ADD	1	/* ADD, ADC */
+ #define	FLAGS_SUB	2	/* SUB, SBC, CMP */
+ #define	FLAGS_LOGIC	3	/* AND, OR, EOR */
+ #define	FlagSync(cpub)	((cpub)->flag_op != FLAGS_VALID		\
+				 ? flag_sync(cpub) : (void)0)
+
+ /*
+  * Memory writes (ST, 'w', 'r') are reported through CodeWrite() so that
+  * translations covering the written word are dropped (cpu-block.c)
+  */
+ #define	CodeWrite(cpub,A)						\
+	 ((A) < IMEMORY_SIZE && BrkTest((cpub)->codemap,(A))		\
+	  ? (void)(BrkSet((cpub)->codedirty,(A)), (cpub)->codestale = 1)	\
+	  : (void)0)
+ 
+ 
  /*=============================================================================
   * Instruction Information Structure (新規追加)
   *===========================================================================*/
@@ -130,6 +226,8 @@
 	 AddressingMode addr_mode_b; // オペランドBのアドレッシングモード (Bフィールドから決定)
 	 ShiftRotateMode shift_mode; // シフト/ローテート命令の場合のモード
 	 BranchCondition branch_cond; // 分岐命令の場合の条件
+	 Uword word_length;          // 命令の語長 (1語 or 2語)
+	 Uword cycles;               // clocks on the board (timing.h)
  
 	 // オペランドフェッチ後のデータ/アドレス情報
 	 Uword operand_a_val;       // オペランドAの値 (レジスタから読み出し後)
@@ -146,10 +244,31 @@
  
  } InstructionInfo;
  
+ // 命令語(1語目)ごとに解読済みの InstructionInfo (init_decode_table() で作成)
+ extern InstructionInfo	decode_table[256];
+ 
  
  /*=============================================================================
   * Top Function of an Instruction Simulation
   *===========================================================================*/
  #define	RUN_HALT	0
  #define	RUN_STEP	1
+ #define	RUN_BREAK	2	/* stopped at a break-point (run_*()) */
+ /*
+  * Boards are independent, so different boards may run in different threads.
+  * The engines build their dispatch tables on the first call; call
+  * run_threaded() and run_block() once with a NULL board before that.
+  */
+ void	init_decode_table(void);
  int	step(Cpub *);
+ void	flag_sync(Cpub *);
+ int	run_step(Cpub *, unsigned long long, unsigned long long *);
+ int	run_threaded(Cpub *, unsigned long long, unsigned long long *);
+ int	run_block(Cpub *, unsigned long long, unsigned long long *);
+ int	run_jit(Cpub *, unsigned long long, unsigned long long *);
+ int	run_jit_check(Cpub *, unsigned long long, unsigned long long *);
+ 
+ /* any of run_*(): run until HLT, a break-point or the limit */
+ typedef int	RunEngine(Cpub *, unsigned long long, unsigned long long *);
+
+#endif	/* CPUBOARD_H */
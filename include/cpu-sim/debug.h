@@ -0,0 +1,78 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	debug.h
+ *	Descrioption:	conditional break-points and data watch-points
+ */
+
+#ifndef	DEBUG_H
+#define	DEBUG_H
+
+#include	<stdio.h>
+#include	"cpuboard.h"
+
+/*=============================================================================
+ *   Break-point Conditions  (e.g. "acc==0f", "zf!=1", "ix>=80")
+ *===========================================================================*/
+#define	DBG_REG_ACC	0
+#define	DBG_REG_IX	1
+#define	DBG_REG_CF	2
+#define	DBG_REG_VF	3
+#define	DBG_REG_NF	4
+#define	DBG_REG_ZF	5
+
+#define	DBG_OP_EQ	0	/* == */
+#define	DBG_OP_NE	1	/* != */
+#define	DBG_OP_LT	2	/* <  (unsigned) */
+#define	DBG_OP_GT	3	/* >  */
+#define	DBG_OP_LE	4	/* <= */
+#define	DBG_OP_GE	5	/* >= */
+
+#define	BRK_COND_MAX	32
+
+typedef struct brkcond {
+	Uword	addr;		/* program address of the break-point */
+	Uword	reg;		/* DBG_REG_* */
+	Uword	op;		/* DBG_OP_* */
+	Uword	value;
+} BrkCond;
+
+
+/*=============================================================================
+ *   Debug Points of a CPU Board  (Cpub::debug, allocated on first use)
+ *
+ *   Cpub::brkmap holds every armed break-point address so that the engines
+ *   test a single bit per instruction.  Addresses whose break-point is
+ *   conditional are also marked in condmap; they stop only if one of their
+ *   conditions holds.  Watch-points are tested by step() on ST writes and
+ *   reported through hit/hit_addr.
+ *===========================================================================*/
+typedef struct debugpoints {
+	Uword	condmap[IMEMORY_SIZE/8];	/* conditional break-points */
+	BrkCond	cond[BRK_COND_MAX];
+	int	ncond;
+	Uword	watchmap[MEMORY_SIZE/8];	/* ST watch-points */
+	int	nwatch;
+	int	hit;		/* a watch-point was written (set by step()) */
+	Addr	hit_addr;
+} DebugPoints;
+
+/* ST into addr by step(): record a watch-point hit */
+#define	DebugWatch(cpub,A)						\
+	do {								\
+		if( (cpub)->debug != NULL				\
+		 && BrkTest((cpub)->debug->watchmap,(A)) ) {		\
+			(cpub)->debug->hit = 1;				\
+			(cpub)->debug->hit_addr = (A);			\
+		}							\
+	} while(0)
+
+DebugPoints	*debug_points(Cpub *);
+int	debug_break(Cpub *);
+int	debug_cond_parse(const char *, BrkCond *);
+void	debug_cond_print(FILE *, const BrkCond *);
+int	debug_cond_add(Cpub *, const BrkCond *);
+void	debug_cond_remove(Cpub *, Addr);
+
+#endif	/* DEBUG_H */
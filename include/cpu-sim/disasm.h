@@ -0,0 +1,42 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	disasm.h
+ *	Descrioption:	disassembler of the Educational CPU instruction set
+ */
+
+#ifndef	DISASM_H
+#define	DISASM_H
+
+#include	<stddef.h>
+#include	"cpuboard.h"
+
+/*=============================================================================
+ *   Disassembler
+ *
+ *   An instruction is rendered from its decode_table entry, i.e. exactly
+ *   as step() decodes it, in the syntax of the assembler (asm.h):
+ *
+ *	LD	ACC,(0x10)	BNZ	0x04	.byte	0x05  (no instruction)
+ *
+ *   Words the assembler would not produce (ST to a register or an
+ *   immediate) are shown as .byte, with their operand word if step()
+ *   fetches one, so that a listing stays aligned with execution.
+ *
+ *   disasm_inst() writes the text of an instruction given its two words
+ *   (e.g. those of a TraceRecord) and returns its word length; disasm()
+ *   does the same for the instruction at a program address.
+ *
+ *   disasm_line() returns the same text from a cache of the program
+ *   area; an entry is kept with the words it was rendered from and
+ *   reused while memory still holds them, so it never needs invalidating
+ *   and repeated listings cost a comparison per instruction.
+ *===========================================================================*/
+#define	DISASM_TEXT	24		/* longest text + '\0' */
+
+int		disasm_inst(Uword, Uword, char *, size_t);
+int		disasm(const Uword *, Addr, char *, size_t);
+const char	*disasm_line(const Uword *, Addr, int *);
+
+#endif	/* DISASM_H */
@@ -0,0 +1,61 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	engine.h
+ *	Descrioption:	operation bodies shared by the fast execution engines
+ */
+
+#ifndef	ENGINE_H
+#define	ENGINE_H
+
+#include	"cpuboard.h"
+
+/*=============================================================================
+ *   Operation Bodies (same results and flags as execute_alu_operation())
+ *
+ *   Expanded inside an engine with locals mem, acc, ix, cf, vf, nf, zf,
+ *   a, b, r (operand B already in b) and ea (its effective address).
+ *===========================================================================*/
+#define	SET_ZN(r)	zf = ((r) == 0), nf = ((r) >> 7)
+#define	SET_VF(a,b,r)	vf = ((~((a) ^ (b)) & ((a) ^ (r))) >> 7) & 1
+
+#define	OP_LD(R)	R = b
+#define	OP_ST(R)	mem[ea] = R
+#define	OP_ADD(R)	a = R, r = a + b, cf = (a + b > 0xff), \
+			SET_VF(a,b,r), SET_ZN(r), R = r
+#define	OP_ADC(R)	a = R, r = a + b + cf, cf = (a + b > 0xff), \
+			SET_VF(a,b,r), SET_ZN(r), R = r
+#define	OP_SUB(R)	a = R, r = a - b, cf = (a >= b), \
+			SET_VF(a,(Uword)-b,r), SET_ZN(r), R = r
+#define	OP_SBC(R)	a = R, r = a - b - cf, cf = (a >= b), \
+			SET_VF(a,(Uword)-b,r), SET_ZN(r), R = r
+#define	OP_CMP(R)	a = R, r = a - b, cf = (a >= b), \
+			SET_VF(a,(Uword)-b,r), SET_ZN(r)
+#define	OP_AND(R)	r = R & b, cf = vf = 0, SET_ZN(r), R = r
+#define	OP_OR(R)	r = R | b, cf = vf = 0, SET_ZN(r), R = r
+#define	OP_EOR(R)	r = R ^ b, cf = vf = 0, SET_ZN(r), R = r
+
+
+/*=============================================================================
+ *   Handler Generation: one label per (operation, register A, mode B)
+ *
+ *   The engine defines HANDLER(OP,X,R,M) for a label named OP_X_M.
+ *===========================================================================*/
+#define	HANDLERS_A(OP,X,R)						\
+	HANDLER(OP,X,R,ACC)  HANDLER(OP,X,R,IX)   HANDLER(OP,X,R,IMM)	\
+	HANDLER(OP,X,R,ABSP) HANDLER(OP,X,R,ABSD) HANDLER(OP,X,R,IXP)	\
+	HANDLER(OP,X,R,IXD)
+#define	HANDLERS(OP)	HANDLERS_A(OP,A,acc) HANDLERS_A(OP,X,ix)
+
+/* label table ordered as AddressingMode (ADDR_MODE_REG_ACC..IX_DATA) */
+#define	LABELS_A(OP,X)	{ &&OP##_##X##_ACC,  &&OP##_##X##_IX,		\
+			  &&OP##_##X##_IMM,  &&OP##_##X##_ABSP,		\
+			  &&OP##_##X##_ABSD, &&OP##_##X##_IXP,		\
+			  &&OP##_##X##_IXD }
+#define	LABELS(OP)	{ LABELS_A(OP,A), LABELS_A(OP,X) }
+
+/* operations with a register/memory operand B, indexed [type - INST_LD] */
+#define	ENGINE_OPS	(INST_EOR - INST_LD + 1)
+
+#endif	/* ENGINE_H */
@@ -0,0 +1,49 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	fork.h
+ *	Descrioption:	checkpoints of a board and copy-on-write children
+ */
+
+#ifndef	FORK_H
+#define	FORK_H
+
+#include	"cpuboard.h"
+
+/*=============================================================================
+ *   Checkpoints and Forks
+ *
+ *   A checkpoint holds a board once; its children share that memory and
+ *   keep only their registers, ports and the FORK_LINE-byte lines they
+ *   have written.  A child runs on a working board: fork_enter() puts it
+ *   there, copying only the lines that differ from what the board holds
+ *   (so the translations of a common program stay), and fork_leave()
+ *   takes it back.  A new child costs no copy of the memory.
+ *===========================================================================*/
+#define	FORK_LINE	16
+#define	FORK_LINES	(MEMORY_SIZE / FORK_LINE)	/* bits of dirty */
+
+typedef struct checkpoint {
+	Cpub		board;		/* registers, ports and mem */
+	IOBuf		input;		/* the word in its ibuf */
+} Checkpoint;
+
+typedef struct forkchild {
+	const Checkpoint	*cp;
+	Uword			pc, acc, ix;
+	Bit			cf, vf, nf, zf;
+	IOBuf			input, obuf;	/* flag and buf */
+	unsigned long		dirty;		/* own lines (bit i: line i) */
+	Uword			*lines;		/* [lines in dirty][FORK_LINE] */
+} Fork;
+
+Checkpoint	*fork_checkpoint(Cpub *);
+void		fork_checkpoint_free(Checkpoint *);
+Fork		*fork_new(const Checkpoint *);
+void		fork_free(Fork *);
+void		fork_enter(Fork *, Cpub *);
+int		fork_leave(Fork *, Cpub *);
+int		fork_lines(const Fork *);
+
+#endif	/* FORK_H */
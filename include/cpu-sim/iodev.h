@@ -0,0 +1,48 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	iodev.h
+ *	Descrioption:	streaming files through the I/O ports of a board
+ */
+
+#ifndef	IODEV_H
+#define	IODEV_H
+
+#include	<stdio.h>
+#include	"cpuboard.h"
+
+/*=============================================================================
+ *   Streaming I/O Devices
+ *
+ *   An input device attached to an IOBuf keeps it full: the next byte of
+ *   the file is in buf with flag raised until the end of the file, and
+ *   every IN takes it and loads the one after.  An output device takes
+ *   every OUT word and leaves flag low, so BNO never waits.  Files are
+ *   read and written in blocks of IODEV_BUFSIZE bytes, or mapped whole
+ *   (input only), so a byte costs no system call.
+ *===========================================================================*/
+#define	IODEV_BUFSIZE	65536
+#define	IODEV_NAMESIZE	160
+
+typedef struct iodev {
+	FILE			*fp;
+	Uword			*buf;		/* [size] block, or the mapped file */
+	size_t			pos, len, size;	/* next byte, bytes in buf */
+	int			output;
+	int			mapped;		/* buf is the file, mmap()ed */
+	int			eof;		/* input: no bytes left */
+	int			error;		/* output: a write failed */
+	unsigned long long	bytes;		/* words through the port */
+	char			name[IODEV_NAMESIZE];
+} IODev;
+
+IODev	*iodev_open(const char *, int, int);
+void	iodev_close(IODev *);
+int	iodev_flush(IODev *);
+void	iodev_reserve(IODev *, size_t);
+void	iodev_attach(IOBuf *, IODev *);
+void	iodev_detach(IOBuf *);
+int	iodev_starved(Cpub *);
+
+#endif	/* IODEV_H */
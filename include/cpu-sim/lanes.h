@@ -0,0 +1,48 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	lanes.h
+ *	Descrioption:	lockstep engine for many boards (structure of arrays)
+ */
+
+#ifndef	LANES_H
+#define	LANES_H
+
+#include	"cpuboard.h"
+
+/*=============================================================================
+ *   Boards in Lanes
+ *
+ *   Every register, flag and memory word is an array with one byte per
+ *   board (lane), so one decoded instruction runs on a vector of boards.
+ *   Arrays are padded to a multiple of LANE_VEC lanes; mem[] holds the
+ *   row of address A at A * stride.  Flags are 0 or 1, live[] is 0xff for
+ *   a running board and 0 once it has halted; run[] is live[] less the
+ *   boards that have used up the limit of the current run_lanes().
+ *===========================================================================*/
+#define	LANE_VEC	32		/* lanes per vector (AVX2) */
+
+typedef struct lanes {
+	int			n;		/* boards */
+	int			nvec;		/* vectors per row */
+	size_t			stride;		/* nvec * LANE_VEC */
+	unsigned char		*pc, *acc, *ix, *cf, *vf, *nf, *zf;
+	unsigned char		*live;
+	unsigned char		*run;		/* live and under the limit */
+	unsigned char		*mem;		/* [MEMORY_SIZE][stride] */
+	unsigned char		*cnt8;		/* counts not yet in count[] */
+	unsigned char		*mask;		/* lanes of the current step */
+	unsigned char		*age;		/* steps waited (up to 255) */
+	IOBuf			*ibuf, *obuf;	/* [n] */
+	unsigned long long	*count;		/* instructions of each board */
+	unsigned long long	*until;		/* count[] at the limit */
+} Lanes;
+
+Lanes	*lanes_new(int);
+void	lanes_free(Lanes *);
+void	lanes_load(Lanes *, int, const Cpub *);
+void	lanes_store(const Lanes *, int, Cpub *);
+int	run_lanes(Lanes *, unsigned long long, unsigned long long *);
+
+#endif	/* LANES_H */
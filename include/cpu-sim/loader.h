@@ -0,0 +1,47 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	loader.h
+ *	Descrioption:	loading programs into the main memory
+ */
+
+#ifndef	LOADER_H
+#define	LOADER_H
+
+#include	"cpuboard.h"
+
+/*=============================================================================
+ *   Program Files
+ *
+ *   Text format: hexadecimal words separated by white space, placed from
+ *   address 000 on; ".text addr" and ".data addr" move to addr of the
+ *   program (0XX) or data (1XX) area.
+ *
+ *   Image format (version 01, integers little-endian), read whole with
+ *   one read and checked before anything is loaded:
+ *
+ *	0	8	magic "CPUIMG01"
+ *	8	1	segments n
+ *	9	1	entry PC
+ *	10	1	ACC
+ *	11	1	IX
+ *	12	1	flags (cf,vf,nf,zf in bits 3..0)
+ *	13	3	zero
+ *	16	4	checksum (FNV-1a of bytes 8..15 and 20..)
+ *	20		n segments: address (2), length (2)
+ *			then the words of the segments in that order
+ *
+ *   read_mem_file() takes either; an image also sets the registers.
+ *   cpu_sim_mkimage converts a text file into an image.
+ *===========================================================================*/
+#define	IMG_MAGIC	"CPUIMG01"
+#define	IMG_HEADER	20
+#define	IMG_SEGMENT	4
+#define	IMG_MAX		(IMG_HEADER + 255 * IMG_SEGMENT + MEMORY_SIZE)
+
+int	read_mem_file(Cpub *, const char *);
+int	read_mem_map(Cpub *, const char *, Uword *);
+int	write_mem_image(const Cpub *, const Uword *, const char *);
+
+#endif	/* LOADER_H */
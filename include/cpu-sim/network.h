@@ -0,0 +1,59 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	network.h
+ *	Descrioption:	networks of CPU boards and their scheduler
+ */
+
+#ifndef	NETWORK_H
+#define	NETWORK_H
+
+#include	"cpuboard.h"
+
+/*=============================================================================
+ *   Network of Boards
+ *
+ *   A board has one input port: its ibuf is the obuf of the board src[i]
+ *   (NET_OPERATOR: input[i], set by hand with 's ibuf').  An obuf may feed
+ *   several boards, e.g. the hub of a star; each word OUT there goes to
+ *   whichever of them executes IN first.  Such a network runs on one
+ *   thread: IN does not claim a word atomically, so readers on different
+ *   threads could both take it.
+ *
+ *	ring		board i reads board i-1, board 0 reads board n-1
+ *	chain		board i reads board i-1, board 0 the operator
+ *	star		every board reads board 0 (the hub), which reads the
+ *			operator
+ *	mesh WxH	board (r,c) = r*W+c reads its west neighbour (r,c-1);
+ *			the first of a row reads the one above it, board 0
+ *			the operator
+ *
+ *   The default, a ring of two, is the original pair of boards.
+ *===========================================================================*/
+#define	NET_MAX_BOARDS	256
+#define	NET_OPERATOR	(-1)		/* src[] of a board fed by hand */
+#define	NET_QUANTUM	10000		/* default instructions per turn */
+
+typedef struct network {
+	int			n;		/* boards */
+	Cpub			*board;		/* [n] */
+	int			*src;		/* [n] board feeding ibuf */
+	IOBuf			*input;		/* [n] input from the operator */
+	unsigned char		*halted;	/* [n] halted in this run */
+	char			topology[32];
+	unsigned long long	quantum;	/* instructions of a turn */
+	int			threads;	/* worker threads (<= 1: none) */
+	int			stopped;	/* board of the last RUN_BREAK */
+} Network;
+
+Network	*net_new(int);
+void	net_free(Network *);
+int	net_topology(Network *, const char *);
+int	net_link(Network *, int, int);
+void	net_connect(Network *);
+Network	*net_read_config(const char *);
+int	run_network(Network *, RunEngine *, unsigned long long,
+						unsigned long long *);
+
+#endif	/* NETWORK_H */
@@ -0,0 +1,63 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	profile.h
+ *	Descrioption:	execution profile of a board (instructions, PCs,
+ *			branches and memory accesses)
+ */
+
+#ifndef	PROFILE_H
+#define	PROFILE_H
+
+#include	<stdio.h>
+#include	"cpuboard.h"
+
+/*=============================================================================
+ *   Profile  (Cpub::prof, NULL: off)
+ *
+ *   step() counts every instruction it executes by InstructionType,
+ *   AddressingMode of operand B and PC, each Bbc as taken or not taken
+ *   for its condition, and the memory words read by operand B or
+ *   written by ST.  Counting is a few array increments per instruction;
+ *   the engines leave a profiled board to step().
+ *===========================================================================*/
+#define	PROF_TYPES	(INST_UNKNOWN + 1)
+#define	PROF_MODES	(ADDR_MODE_NONE + 1)
+#define	PROF_CONDS	(BRANCH_COND_NONE + 1)
+#define	PROF_TOP	16		/* PCs and addresses in a report */
+
+typedef struct profile {
+	unsigned long long	total;
+	unsigned long long	type[PROF_TYPES];
+	unsigned long long	mode[PROF_MODES];
+	unsigned long long	pc[IMEMORY_SIZE];
+	unsigned long long	branch[PROF_CONDS][2];	/* [cond][taken] */
+	unsigned long long	read[MEMORY_SIZE];
+	unsigned long long	write[MEMORY_SIZE];
+} Profile;
+
+static inline void
+prof_count(Profile *p, const InstructionInfo *info)
+{
+	p->total++;
+	p->type[info->type]++;
+	p->mode[info->addr_mode_b]++;
+	p->pc[info->pc_at_fetch & 0xff]++;
+	if( info->type == INST_Bbc )
+		p->branch[info->branch_cond][info->is_branch_taken != 0]++;
+	else if( info->type == INST_ST )
+		p->write[info->effective_addr]++;
+	else if( info->type >= INST_LD && info->type <= INST_EOR
+	      && info->addr_mode_b >= ADDR_MODE_ABS_PROG
+	      && info->addr_mode_b <= ADDR_MODE_IX_DATA )
+		p->read[info->effective_addr]++;
+}
+
+Profile	*prof_create(void);
+void	prof_free(Profile *);
+void	prof_clear(Profile *);
+void	prof_report(FILE *, const Profile *);
+int	prof_save_csv(const Profile *, const char *);
+
+#endif	/* PROFILE_H */
@@ -0,0 +1,46 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	snapshot.h
+ *	Descrioption:	snapshots of the boards and their connections
+ */
+
+#ifndef	SNAPSHOT_H
+#define	SNAPSHOT_H
+
+#include	<stddef.h>
+#include	"cpuboard.h"
+#include	"network.h"
+
+/*=============================================================================
+ *   Snapshot Format (version 01, integers little-endian)
+ *
+ *	0	8	magic "CPUSNP01"
+ *	8	2	boards n
+ *	10	2	threads
+ *	12	8	quantum
+ *	20	32	topology (NUL-padded)
+ *	52		a SNAP_RECORD-byte record per board: pc, acc, ix,
+ *			flags (cf,vf,nf,zf in bits 3..0), the flag and buf of
+ *			its operator input and of its obuf, src as 2 bytes
+ *			(0xffff: the operator), 6 zero bytes, mem[MEMORY_SIZE]
+ *
+ *   Break/watch-points, trace rings and I/O devices are not part of a
+ *   snapshot and stay as they are on a restore; translations are dropped
+ *   only where the program area changes.
+ *===========================================================================*/
+#define	SNAP_MAGIC	"CPUSNP01"
+#define	SNAP_HEADER	52
+#define	SNAP_RECORD	(16 + MEMORY_SIZE)
+#define	SnapSize(n)	(SNAP_HEADER + (size_t)(n) * SNAP_RECORD)
+
+void		snap_encode_board(Cpub *, const IOBuf *, int, unsigned char *);
+void		snap_decode_board(Cpub *, IOBuf *, const unsigned char *);
+void		snap_encode(Network *, unsigned char *);
+int		snap_decode(Network *, const unsigned char *, size_t);
+unsigned char	*snap_read(const char *, size_t *);
+int		snap_save(Network *, const char *);
+int		snap_load(Network **, const char *);
+
+#endif	/* SNAPSHOT_H */
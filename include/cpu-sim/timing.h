@@ -0,0 +1,46 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	timing.h
+ *	Descrioption:	clock cycle count of a board (timing model)
+ */
+
+#ifndef	TIMING_H
+#define	TIMING_H
+
+#include	<stdio.h>
+#include	"cpuboard.h"
+
+/*=============================================================================
+ *   Timing Model  (Cpub::timing, NULL: off)
+ *
+ *   An instruction of the board takes one clock per phase: P0-P2 (fetch,
+ *   decode, execute), one more to fetch a 2nd word and one more for a
+ *   memory operand.  So
+ *
+ *	3 clocks	NOP, HLT, IN, OUT, RCF, SCF, JR, shifts, register B
+ *	4 clocks	immediate B, Bbc, JAL
+ *	5 clocks	LD, ST and the ALU with [d], (d), [IX+d], (IX+d)
+ *
+ *   init_decode_table() puts the count in InstructionInfo::cycles and
+ *   step() adds it up while a Timing is attached; the engines leave a
+ *   timed board to step().  The runtime on the board is cycles / hz.
+ *===========================================================================*/
+#define	TIMING_HZ	1000000UL	/* default clock of the board */
+
+typedef struct timing {
+	unsigned long long	cycles;
+	unsigned long long	count;	/* instructions */
+	unsigned long		hz;	/* clock of the board */
+} Timing;
+
+#define	TimingCount(t,info)	((t)->cycles += (info)->cycles, (t)->count++)
+
+Timing	*timing_create(unsigned long);
+void	timing_free(Timing *);
+void	timing_clear(Timing *);
+double	timing_seconds(const Timing *, unsigned long long);
+void	timing_report(FILE *, const Timing *);
+
+#endif	/* TIMING_H */
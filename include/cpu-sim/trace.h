@@ -0,0 +1,98 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	trace.h
+ *	Descrioption:	debug trace facility (build-time and run-time levels,
+ *			binary trace ring buffer)
+ */
+
+#ifndef	TRACE_H
+#define	TRACE_H
+
+#include	<stdio.h>
+#include	"cpuboard.h"
+
+/*=============================================================================
+ *   Trace Levels
+ *===========================================================================*/
+#define	TRACE_LEVEL_OFF		0	/* no trace output */
+#define	TRACE_LEVEL_INST	1	/* one line per instruction */
+#define	TRACE_LEVEL_PHASE	2	/* every phase of an instruction */
+
+/*
+ *   Highest level compiled in (set by the CPU_SIM_TRACE CMake option).
+ *   Trace points above this level expand to nothing.
+ */
+#ifndef	CPU_SIM_TRACE_MAX
+#define	CPU_SIM_TRACE_MAX	TRACE_LEVEL_INST
+#endif
+
+extern int	trace_level;	/* current run-time level */
+
+#if	CPU_SIM_TRACE_MAX >= TRACE_LEVEL_INST
+#define	TRACE_INST(...)		do { if( trace_level >= TRACE_LEVEL_INST ) \
+					printf(__VA_ARGS__); } while(0)
+#else
+#define	TRACE_INST(...)		do { } while(0)
+#endif
+
+#if	CPU_SIM_TRACE_MAX >= TRACE_LEVEL_PHASE
+#define	TRACE_PHASE(...)	do { if( trace_level >= TRACE_LEVEL_PHASE ) \
+					printf(__VA_ARGS__); } while(0)
+#else
+#define	TRACE_PHASE(...)	do { } while(0)
+#endif
+
+/* true while any trace output is enabled (always false when compiled out) */
+#if	CPU_SIM_TRACE_MAX > TRACE_LEVEL_OFF
+#define	TRACE_ENABLED()		(trace_level != TRACE_LEVEL_OFF)
+#else
+#define	TRACE_ENABLED()		0
+#endif
+
+int	trace_set_level(const char *);
+const char	*trace_level_name(int);
+
+
+/*=============================================================================
+ *   Binary Trace Ring Buffer
+ *
+ *   One fixed-size record per executed instruction, written by step()
+ *   while a ring is attached to the board (Cpub::trace).  Only bytes are
+ *   stored, so dumped files are independent of the host byte order.
+ *===========================================================================*/
+#define	TRACE_FLAGS(c)	(Uword)(((c)->cf << 3) | ((c)->vf << 2) | \
+				((c)->nf << 1) | (c)->zf)
+
+typedef struct {
+	Uword	pc[2];		/* PC at fetch / after the instruction */
+	Uword	inst[2];	/* 1st and 2nd instruction words */
+	Uword	acc[2];		/* ACC before / after */
+	Uword	ix[2];		/* IX before / after */
+	Uword	flags[2];	/* CF,VF,NF,ZF (bit 3..0) before / after */
+	Uword	ea[2];		/* effective address (low, high byte) */
+	Uword	type;		/* InstructionType */
+	Uword	halted;		/* 1 if the instruction stopped the CPU */
+	Uword	reserved[2];
+} TraceRecord;			/* 16 bytes */
+
+typedef struct tracering {
+	TraceRecord		*rec;
+	unsigned long		mask;	/* capacity - 1 (power of two) */
+	unsigned long long	head;	/* number of records ever written */
+} TraceRing;
+
+#define	TRACE_RING_DEFAULT	4096
+#define	TRACE_RING_MAX		(1UL << 24)	/* records (256MB) */
+#define	TraceRingNext(r)	(&(r)->rec[(r)->head++ & (r)->mask])
+
+TraceRing	*trace_ring_create(unsigned long);
+void		trace_ring_free(TraceRing *);
+unsigned long	trace_ring_count(TraceRing *);
+TraceRecord	*trace_ring_get(TraceRing *, unsigned long);
+int		trace_ring_save(TraceRing *, const char *);
+TraceRing	*trace_ring_load(const char *);
+void		trace_render(FILE *, const TraceRecord *);
+
+#endif	/* TRACE_H */
@@ -0,0 +1,74 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	undo.h
+ *	Descrioption:	undo log of executed instructions (reverse execution)
+ */
+
+#ifndef	UNDO_H
+#define	UNDO_H
+
+#include	<stddef.h>
+#include	"cpuboard.h"
+
+/*=============================================================================
+ *   Undo Log  (Cpub::undo, NULL: off)
+ *
+ *   step() appends a record per instruction holding only what it changed:
+ *
+ *	[old mem byte: addr low, addr high, value]	ST
+ *	[old ports: flags (ibuf 1, obuf 0), ibuf, obuf]	IN, OUT
+ *	[old IX] [old ACC]
+ *	old PC, header (old CF,VF,NF,ZF in bits 3..0; which of ACC 4,
+ *		IX 5, mem 6 and ports 7 follow)
+ *
+ *   Records are read backwards from their header, so most instructions
+ *   take 2 or 3 bytes.  The log is kept in segments of UNDO_SEGMENT
+ *   records, each starting with a mark of the whole board, so that a
+ *   long step back restores marks instead of undoing record by record;
+ *   the oldest segments are dropped beyond the limit (bytes).
+ *
+ *   The engines leave a board with a log to step().  I/O devices and
+ *   changes made by hand are not undone.
+ *===========================================================================*/
+#define	UNDO_SEGMENT	65536		/* records of a segment */
+#define	UNDO_DEFAULT	(64UL << 20)	/* default limit (bytes) */
+
+typedef struct undoregs {
+	Uword	pc, acc, ix, flags;
+	Uword	iflag, ibuf, oflag, obuf;
+} UndoRegs;
+
+typedef struct undomark {
+	UndoRegs	r;
+	Uword		mem[MEMORY_SIZE];
+} UndoMark;
+
+typedef struct undoseg {
+	struct undoseg	*prev, *next;	/* older, newer */
+	UndoMark	mark;		/* the board before its first record */
+	unsigned long	n;		/* records */
+	size_t		len, size;	/* bytes used, allocated */
+	Uword		*bytes;
+} UndoSeg;
+
+typedef struct undolog {
+	UndoSeg			*first, *last;	/* oldest, newest */
+	unsigned long long	n;		/* records held */
+	size_t			size, limit;	/* bytes allocated, limit */
+	int			st_addr;	/* ST of the instruction (-1) */
+	Uword			st_old;
+	UndoRegs		pend;		/* registers before it */
+} UndoLog;
+
+UndoLog			*undo_create(size_t);
+void			undo_free(UndoLog *);
+void			undo_clear(UndoLog *);
+void			undo_begin(Cpub *);
+void			undo_store(Cpub *, Addr);
+void			undo_end(Cpub *);
+int			undo_back(Cpub *, int *);
+unsigned long long	undo_seek(Cpub *, unsigned long long);
+
+#endif	/* UNDO_H */
@@ -0,0 +1,561 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	asm.c
+ *	Descrioption:	assembler of the Educational CPU instruction set
+ */
+
+#define	_POSIX_C_SOURCE	200809L	/* strcasecmp() */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<strings.h>
+#include	<stdarg.h>
+#include	<ctype.h>
+#include	"cpuboard.h"
+#include	"asm.h"
+
+#define	LINESIZE	256
+#define	NAMESIZE	32
+
+static const struct {
+	const char	*name;
+	InstructionType	type;
+	int		sub;	/* BranchCondition, or the sm field of a shift */
+} mnemonics[] = {
+	{ "NOP", INST_NOP, 0 },	{ "HLT", INST_HLT, 0 },
+	{ "OUT", INST_OUT, 0 },	{ "IN", INST_IN, 0 },
+	{ "RCF", INST_RCF, 0 },	{ "SCF", INST_SCF, 0 },
+	{ "LD", INST_LD, 0 },	{ "ST", INST_ST, 0 },
+	{ "ADD", INST_ADD, 0 },	{ "ADC", INST_ADC, 0 },
+	{ "SUB", INST_SUB, 0 },	{ "SBC", INST_SBC, 0 },
+	{ "CMP", INST_CMP, 0 },	{ "AND", INST_AND, 0 },
+	{ "OR", INST_OR, 0 },	{ "EOR", INST_EOR, 0 },
+	{ "SRA", INST_Ssm, 0 },	{ "SLA", INST_Ssm, 1 },
+	{ "SRL", INST_Ssm, 2 },	{ "SLL", INST_Ssm, 3 },
+	{ "RRA", INST_Rsm, 0 },	{ "RLA", INST_Rsm, 1 },
+	{ "RRL", INST_Rsm, 2 },	{ "RLL", INST_Rsm, 3 },
+	{ "BA", INST_Bbc, BRANCH_COND_A },   { "BVF", INST_Bbc, BRANCH_COND_VF },
+	{ "BNZ", INST_Bbc, BRANCH_COND_NZ }, { "BZ", INST_Bbc, BRANCH_COND_Z },
+	{ "BZP", INST_Bbc, BRANCH_COND_ZP }, { "BN", INST_Bbc, BRANCH_COND_N },
+	{ "BP", INST_Bbc, BRANCH_COND_P },   { "BZN", INST_Bbc, BRANCH_COND_ZN },
+	{ "BNI", INST_Bbc, BRANCH_COND_NI }, { "BNO", INST_Bbc, BRANCH_COND_NO },
+	{ "BNC", INST_Bbc, BRANCH_COND_NC }, { "BC", INST_Bbc, BRANCH_COND_C },
+	{ "BGE", INST_Bbc, BRANCH_COND_GE }, { "BLT", INST_Bbc, BRANCH_COND_LT },
+	{ "BGT", INST_Bbc, BRANCH_COND_GT }, { "BLE", INST_Bbc, BRANCH_COND_LE },
+	{ "JAL", INST_JAL, 0 },	{ "JR", INST_JR, 0 },
+};
+#define	NMNEMONICS	(int)(sizeof(mnemonics)/sizeof(mnemonics[0]))
+
+
+/*=============================================================================
+ *   Encoder Tables (inverse of decode_table; the lowest word wins)
+ *===========================================================================*/
+static short	enc_op[INST_UNKNOWN][2][ADDR_MODE_NONE + 1];
+static short	enc_branch[BRANCH_COND_NONE];
+static short	enc_shift[2][4];		/* [Rsm][sm] */
+static int	enc_ready = 0;
+
+static void
+build_encoder(void)
+{
+	const InstructionInfo	*e;
+	int			w;
+
+	memset(enc_op,0xff,sizeof(enc_op));		/* -1 */
+	memset(enc_branch,0xff,sizeof(enc_branch));
+	memset(enc_shift,0xff,sizeof(enc_shift));
+	for( w = 255 ; w >= 0 ; w-- ) {
+		e = &decode_table[w];
+		switch( e->type ) {
+		   case INST_Bbc:
+			if( e->branch_cond < BRANCH_COND_NONE )
+				enc_branch[e->branch_cond] = w;
+			break;
+		   case INST_Ssm: case INST_Rsm:
+			enc_shift[e->type == INST_Rsm][e->shift_mode & 3] = w;
+			break;
+		   case INST_UNKNOWN:
+			break;
+		   case INST_LD: case INST_ST:
+		   case INST_ADD: case INST_ADC: case INST_SUB:
+		   case INST_SBC: case INST_CMP: case INST_AND:
+		   case INST_OR: case INST_EOR:
+			if( e->addr_mode_b != ADDR_MODE_NONE )
+				enc_op[e->type][e->a_field][e->addr_mode_b] = w;
+			break;
+		   default:
+			enc_op[e->type][0][ADDR_MODE_NONE] = w;
+			break;
+		}
+	}
+	enc_ready = 1;
+}
+
+
+/*=============================================================================
+ *   Assembler State
+ *===========================================================================*/
+typedef struct label {
+	char	name[NAMESIZE];
+	int	value;
+} Label;
+
+typedef struct assembler {
+	const char	*file;
+	int		line;
+	int		pass;		/* 1: labels, 2: words */
+	int		addr;		/* location counter */
+	Label		*labels;
+	int		nlabels;
+	int		errors;
+	Uword		*mem, *map;
+} Asm;
+
+static void
+report(Asm *as, const char *fmt, va_list ap)
+{
+	as->errors++;
+	fprintf(stderr,"%s:%d: ",as->file,as->line);
+	vfprintf(stderr,fmt,ap);
+	fprintf(stderr,"\n");
+}
+
+/* an error of the words, found again by pass 2 and reported then */
+static void
+asm_error(Asm *as, const char *fmt, ...)
+{
+	va_list	ap;
+
+	if( as->pass != 2 )
+		return;
+	va_start(ap,fmt);
+	report(as,fmt,ap);
+	va_end(ap);
+}
+
+/* an error of the labels, found only by pass 1 */
+static void
+label_error(Asm *as, const char *fmt, ...)
+{
+	va_list	ap;
+
+	va_start(ap,fmt);
+	report(as,fmt,ap);
+	va_end(ap);
+}
+
+static Label *
+find_label(Asm *as, const char *name)
+{
+	int	i;
+
+	for( i = 0 ; i < as->nlabels ; i++ )
+		if( !strcasecmp(as->labels[i].name,name) )
+			return &as->labels[i];
+	return NULL;
+}
+
+static void
+define_label(Asm *as, const char *name)
+{
+	Label	*p;
+	size_t	len = strlen(name);
+
+	if( as->pass != 1 )
+		return;
+	if( len >= NAMESIZE ) {
+		label_error(as,"Label too long: %s",name);
+		return;
+	}
+	if( find_label(as,name) != NULL ) {
+		label_error(as,"Duplicate label: %s",name);
+		return;
+	}
+	if( (p = realloc(as->labels,(as->nlabels + 1) * sizeof(Label)))
+								== NULL ) {
+		label_error(as,"Too many labels");
+		return;
+	}
+	as->labels = p;
+	p = &as->labels[as->nlabels++];
+	memcpy(p->name,name,len + 1);
+	p->value = as->addr;
+}
+
+static void
+emit(Asm *as, int word)
+{
+	if( as->addr >= MEMORY_SIZE ) {
+		asm_error(as,"Program too large");
+		return;
+	}
+	if( as->pass == 2 ) {
+		as->mem[as->addr] = (Uword)word;
+		BrkSet(as->map,as->addr);
+	}
+	as->addr++;
+}
+
+
+/*=============================================================================
+ *   Operands
+ *===========================================================================*/
+static int
+is_name_char(int c, int first)
+{
+	return isalpha(c) || c == '_' || c == '.' || (!first && isdigit(c));
+}
+
+/* ACC (0), IX (1) or -1 */
+static int
+reg_name(const char *s)
+{
+	if( !strcasecmp(s,"ACC") )
+		return 0;
+	if( !strcasecmp(s,"IX") )
+		return 1;
+	return -1;
+}
+
+/*
+ *   d: numbers and labels joined by + and - (no blanks, see operands());
+ *   -1 on a syntax error
+ */
+static int
+expression(Asm *as, const char *s, int *value)
+{
+	char		name[NAMESIZE];
+	const Label	*l;
+	char		*end;
+	int		sign = 1, n;
+
+	*value = 0;
+	if( *s == '\0' )
+		return -1;
+	while( *s != '\0' ) {
+		if( *s == '+' || *s == '-' ) {
+			sign = (*s == '-') ? -1 : 1;
+			s++;
+		} else if( *value != 0 || sign != 1 )
+			return -1;
+		if( isdigit((unsigned char)*s) ) {
+			*value += sign * (int)strtol(s,&end,16);
+			s = end;
+			if( *s == 'h' || *s == 'H' )
+				s++;
+		} else if( is_name_char((unsigned char)*s,1) ) {
+			for( n = 0 ; is_name_char((unsigned char)*s,0) ; s++ )
+				if( n < NAMESIZE )
+					name[n++] = *s;
+			if( n == NAMESIZE )
+				return -1;
+			name[n] = '\0';
+			if( (l = find_label(as,name)) != NULL )
+				*value += sign * l->value;
+			else if( as->pass == 2 ) {
+				asm_error(as,"Undefined label: %s",name);
+				return 0;
+			}
+		} else
+			return -1;
+		if( *s != '\0' && *s != '+' && *s != '-' )
+			return -1;
+		sign = 0;		/* an operator must follow */
+	}
+	return 0;
+}
+
+/*
+ *   Operand B: its addressing mode and word (value); -1 on a syntax error
+ */
+static int
+operand_b(Asm *as, char *s, AddressingMode *mode, int *value)
+{
+	char	close;
+	size_t	len;
+	int	indexed = 0, max = 0xff;
+
+	*value = 0;
+	switch( reg_name(s) ) {
+	   case 0:	*mode = ADDR_MODE_REG_ACC; return 0;
+	   case 1:	*mode = ADDR_MODE_REG_IX; return 0;
+	}
+	if( *s != '[' && *s != '(' ) {
+		*mode = ADDR_MODE_IMMEDIATE;
+		return expression(as,s,value);
+	}
+
+	close = (*s == '[') ? ']' : ')';
+	len = strlen(s);
+	if( len < 3 || s[len-1] != close )
+		return -1;
+	s[len-1] = '\0';
+	s++;
+	len -= 2;
+	if( !strncasecmp(s,"IX+",3) ) {
+		indexed = 1;
+		s += 3;
+	} else if( len > 3 && !strcasecmp(s + len - 3,"+IX") ) {
+		indexed = 1;
+		s[len-3] = '\0';
+	}
+	if( close == ']' )
+		*mode = indexed ? ADDR_MODE_IX_PROG : ADDR_MODE_ABS_PROG;
+	else {
+		*mode = indexed ? ADDR_MODE_IX_DATA : ADDR_MODE_ABS_DATA;
+		max = MEMORY_SIZE - 1;
+	}
+	if( expression(as,s,value) != 0 )
+		return -1;
+	if( *value < -0x80 || *value > max ) {
+		asm_error(as,"Address out of range: 0x%x",*value);
+		*value = 0;
+	}
+	return 0;
+}
+
+/*
+ *   Split the operand field at commas (blanks removed); returns the count,
+ *   or -1 if blanks separate two words of one operand
+ */
+static int
+operands(char *s, char *op[], int max)
+{
+	char	*d = s;
+	int	n = 0;
+
+	for( ; *s != '\0' ; s++ ) {
+		if( !isspace((unsigned char)*s) ) {
+			*d++ = *s;
+			continue;
+		}
+		while( isspace((unsigned char)s[1]) )
+			s++;
+		if( d > op[0] && isalnum((unsigned char)d[-1])
+		 && isalnum((unsigned char)s[1]) )
+			return -1;
+	}
+	*d = '\0';
+	if( *(s = op[0]) == '\0' )
+		return 0;
+	for( n = 1 ; n < max && (d = strchr(s,',')) != NULL ; n++ ) {
+		*d = '\0';
+		op[n] = s = d + 1;
+	}
+	return strchr(s,',') != NULL ? max + 1 : n;
+}
+
+
+/*=============================================================================
+ *   Lines
+ *===========================================================================*/
+static void
+directive(Asm *as, const char *name, char *op[], int n)
+{
+	int	value, i;
+
+	if( !strcasecmp(name,".text") || !strcasecmp(name,".data") ) {
+		value = 0;
+		if( n > 1 || (n == 1 && (expression(as,op[0],&value) != 0
+					|| value < 0 || value > 0xff)) ) {
+			asm_error(as,"Invalid address: %s",n ? op[0] : "");
+			return;
+		}
+		as->addr = (tolower((unsigned char)name[1]) == 'd' ? 0x100 : 0)
+								| value;
+	} else if( !strcasecmp(name,".byte") ) {
+		for( i = 0 ; i < n ; i++ ) {
+			if( expression(as,op[i],&value) != 0
+			 || value < -0x80 || value > 0xff ) {
+				asm_error(as,"Invalid value: %s",op[i]);
+				value = 0;
+			}
+			emit(as,value & 0xff);
+		}
+	} else
+		asm_error(as,"Unknown directive: %s",name);
+}
+
+static void
+instruction(Asm *as, const char *name, char *op[], int n)
+{
+	AddressingMode	mode = ADDR_MODE_NONE;
+	int		i, a = 0, word = -1, value = 0;
+
+	for( i = 0 ; i < NMNEMONICS && strcasecmp(name,mnemonics[i].name) ; i++ )
+		;
+	if( i == NMNEMONICS ) {
+		asm_error(as,"Unknown instruction: %s",name);
+		return;
+	}
+
+	switch( mnemonics[i].type ) {
+	   case INST_LD: case INST_ST:
+	   case INST_ADD: case INST_ADC: case INST_SUB:
+	   case INST_SBC: case INST_CMP: case INST_AND:
+	   case INST_OR: case INST_EOR:
+		if( n != 2 || (a = reg_name(op[0])) < 0
+		 || operand_b(as,op[1],&mode,&value) != 0 )
+			goto syntax;
+		if( mnemonics[i].type == INST_ST && mode <= ADDR_MODE_IMMEDIATE ) {
+			asm_error(as,"ST needs a memory operand");
+			return;
+		}
+		word = enc_op[mnemonics[i].type][a][mode];
+		break;
+	   case INST_Ssm: case INST_Rsm:
+		if( n != 1 || (a = reg_name(op[0])) < 0 )
+			goto syntax;
+		if( a != 0 ) {		/* no register field in decode_table */
+			asm_error(as,"%s takes ACC only",name);
+			return;
+		}
+		word = enc_shift[mnemonics[i].type == INST_Rsm][mnemonics[i].sub];
+		break;
+	   case INST_Bbc:
+	   case INST_JAL:
+		if( n != 1 || expression(as,op[0],&value) != 0 )
+			goto syntax;
+		if( value < 0 || value > 0xff ) {
+			asm_error(as,"Address out of range: 0x%x",value);
+			value = 0;
+		}
+		word = (mnemonics[i].type == INST_Bbc)
+				? enc_branch[mnemonics[i].sub]
+				: enc_op[INST_JAL][0][ADDR_MODE_NONE];
+		break;
+	   default:
+		if( n != 0 )
+			goto syntax;
+		word = enc_op[mnemonics[i].type][0][ADDR_MODE_NONE];
+		break;
+	}
+	if( word < 0 ) {
+		asm_error(as,"No encoding for %s",name);
+		return;
+	}
+	if( mode == ADDR_MODE_IMMEDIATE && (value < -0x80 || value > 0xff) ) {
+		asm_error(as,"Value out of range: 0x%x",value);
+		value = 0;
+	}
+	emit(as,word);
+	if( decode_table[word].word_length == 2 )
+		emit(as,value & 0xff);
+	return;
+
+     syntax:
+	asm_error(as,"Syntax error in operands of %s",name);
+}
+
+static void
+assemble_line(Asm *as, char *line)
+{
+	char	*op[8], *p, *name;
+	int	n;
+
+	for( p = line ; *p != '\0' ; p++ )	/* comment */
+		if( *p == ';' || *p == '#' || (p[0] == '/' && p[1] == '/') ) {
+			*p = '\0';
+			break;
+		}
+
+	for( p = line ; isspace((unsigned char)*p) ; p++ )
+		;
+	name = p;
+	while( is_name_char((unsigned char)*p,p == name) )
+		p++;
+	if( *p == ':' && p > name ) {		/* label */
+		*p++ = '\0';
+		if( reg_name(name) >= 0 )
+			asm_error(as,"Invalid label: %s",name);
+		else
+			define_label(as,name);
+		while( isspace((unsigned char)*p) )
+			p++;
+		name = p;
+		while( is_name_char((unsigned char)*p,p == name) )
+			p++;
+	}
+	if( p == name ) {
+		if( *p != '\0' && !isspace((unsigned char)*p) )
+			asm_error(as,"Syntax error");
+		return;
+	}
+	if( *p != '\0' && !isspace((unsigned char)*p) ) {
+		asm_error(as,"Syntax error");
+		return;
+	}
+	if( *p != '\0' )
+		*p++ = '\0';
+
+	op[0] = p;
+	if( (n = operands(p,op,8)) < 0 || n > 8 ) {
+		asm_error(as,n < 0 ? "Syntax error in operands of %s"
+				   : "Too many operands of %s",name);
+		return;
+	}
+	if( name[0] == '.' )
+		directive(as,name,op,n);
+	else
+		instruction(as,name,op,n);
+}
+
+
+/*=============================================================================
+ *   Assemble a File
+ *
+ *   asm_assemble() writes the words into mem and marks them in map (1
+ *   bit/address); asm_file() loads them into a board.  Both return 0,
+ *   or -1 after reporting the errors.
+ *===========================================================================*/
+int
+asm_assemble(const char *file, Uword *mem, Uword *map)
+{
+	FILE	*fp;
+	Asm	as;
+	char	line[LINESIZE];
+
+	if( !enc_ready )
+		build_encoder();
+	if( (fp = fopen(file,"r")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		return -1;
+	}
+	memset(&as,0,sizeof(as));
+	as.file = file;
+	as.mem = mem;
+	as.map = map;
+	for( as.pass = 1 ; as.pass <= 2 ; as.pass++ ) {
+		rewind(fp);
+		as.line = 0;
+		as.addr = 0;
+		while( fgets(line,LINESIZE,fp) != NULL ) {
+			as.line++;
+			assemble_line(&as,line);
+		}
+	}
+	fclose(fp);
+	free(as.labels);
+	return as.errors ? -1 : 0;
+}
+
+
+int
+asm_file(Cpub *cpub, const char *file)
+{
+	Uword	mem[MEMORY_SIZE], map[MEMORY_SIZE/8];
+	int	addr;
+
+	memset(map,0,sizeof(map));
+	if( asm_assemble(file,mem,map) != 0 )
+		return -1;
+	for( addr = 0 ; addr < MEMORY_SIZE ; addr++ )
+		if( BrkTest(map,addr) ) {
+			cpub->mem[addr] = mem[addr];
+			CodeWrite(cpub,addr);
+		}
+	return 0;
+}
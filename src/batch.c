@@ -0,0 +1,638 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	batch.c
+ *	Descrioption:	headless batch runner (many programs, no prompt)
+ */
+
+#define	_POSIX_C_SOURCE	200809L	/* clock_gettime(), getopt(), dup() */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<time.h>
+#include	<unistd.h>
+#include	<pthread.h>
+#include	"cpuboard.h"
+#include	"block.h"
+#include	"loader.h"
+#include	"lanes.h"
+#include	"snapshot.h"
+
+
+/*=============================================================================
+ *   Main Routine: cpu_sim_batch [options] [program[,setup] ...]
+ *
+ *	-e engine	block (default), threaded, step, jit or lanes
+ *	-l count	instruction limit of a job (default 100000000)
+ *	-f json|bin	output format (default json)
+ *	-o file		output file (default: the standard output)
+ *	-j file		jobs, one "program [setup]" per line (before the
+ *			jobs of the command line)
+ *	-t threads	worker threads (default: one per online CPU)
+ *
+ *   Every job starts from a cleared board, loads the program (the format
+ *   of 'r'; "-" for none), applies the setup file and runs to HLT or the
+ *   limit.  Jobs run in parallel on a pool of workers, each with a board
+ *   of its own (see Worker); with -e lanes a worker runs its jobs
+ *   LANES_GROUP at a time in the lanes of run_lanes().
+ *
+ *   A setup file holds interpreter commands: "s reg data", "w addr data"
+ *   (or "sm"), "r file" and "q"; d, m, c, h, ? and '#' comments are
+ *   skipped, so test/test_setup_commands.txt works as is.  A snapshot
+ *   written with 'save' may stand for a setup file: board 0 of it is
+ *   restored instead, with no commands to replay.
+ *
+ *   The final states are written in job order once all jobs are done:
+ *	json	one object per line: {"program":..,"setup":..,"status":
+ *		"halt"|"limit"|"error","count":..,"pc":..,"acc":..,"ix":..,
+ *		"cf":..,"vf":..,"nf":..,"zf":..,"obuf":..,"mem":"<hex>"}
+ *	bin	8-byte magic "CPUBAT01", then a BATCH_RECORD-byte record
+ *		per job: status (0 halt, 1 limit, 2 error), pc, acc, ix,
+ *		flags (cf,vf,nf,zf in bits 3..0), obuf, 2 zero bytes, the
+ *		count as 8 bytes little-endian, mem[MEMORY_SIZE]
+ *
+ *   Exits with 0 if every job halted, 1 otherwise and 2 on a usage error.
+ *===========================================================================*/
+#define	BATCH_MAGIC	"CPUBAT01"
+#define	BATCH_RECORD	(16 + MEMORY_SIZE)
+#define	BATCH_LIMIT	100000000ULL
+#define	LANES_GROUP	256		/* jobs in the lanes of a worker */
+
+#define	JOB_HALT	0
+#define	JOB_LIMIT	1
+#define	JOB_ERROR	2
+
+static const char	*status_names[] = { "halt", "limit", "error" };
+
+static const struct {
+	const char	*name;
+	RunEngine	*run;
+} engines[] = {
+	{ "block",	run_block },
+	{ "threaded",	run_threaded },
+	{ "step",	run_step },
+	{ "jit",	run_jit },
+	{ "lanes",	NULL },		/* run_lanes(), see run_lanes_jobs() */
+};
+#define	NENGINES	(int)(sizeof(engines)/sizeof(engines[0]))
+
+/* a job and, once run, its final state */
+typedef struct job {
+	char			*program, *setup;
+	int			status;
+	unsigned long long	count;
+	Uword			pc, acc, ix, flags, obuf;
+	Uword			mem[MEMORY_SIZE];
+} Job;
+
+/*
+ *   A worker owns the jobs [next,end) of the table.  When they are done
+ *   it steals the upper half of the jobs left to another worker.
+ */
+typedef struct worker {
+	pthread_t		thread;
+	pthread_mutex_t		lock;		/* next, end */
+	int			next, end;
+	Cpub			board;
+	IOBuf			input;
+	Lanes			*lanes;		/* -e lanes */
+	unsigned long long	total;		/* instructions run */
+} Worker;
+
+static RunEngine		*run = run_block;
+static unsigned long long	limit = BATCH_LIMIT;
+static int			binary = 0;
+static FILE			*out;
+
+static Job			*jobs;
+static int			njobs, maxjobs;
+static Worker			*workers;
+static int			nworkers;
+
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr,"usage: %s [-e engine] [-l count] [-f json|bin] "
+			"[-o file] [-j file] [-t threads] "
+			"[program[,setup] ...]\n",prog);
+}
+
+
+/*=============================================================================
+ *   Clear the Board for a Job (keeping its translation cache)
+ *===========================================================================*/
+static void
+reset_board(Cpub *cpub, IOBuf *input)
+{
+	struct blockcache	*bc = cpub->blocks;
+
+	memset(cpub,0,sizeof(*cpub));
+	memset(input,0,sizeof(*input));
+	cpub->ibuf = input;
+	cpub->blocks = bc;
+	if( bc != NULL )
+		block_flush(cpub,bc);
+}
+
+
+/*=============================================================================
+ *   Apply a Setup File (or Snapshot)
+ *
+ *   Returns 0 on success and -1 for an unreadable file or a bad command.
+ *===========================================================================*/
+static int
+set_register(Cpub *cpub, const char *name, const char *strval)
+{
+	unsigned int	value, max = 1;
+	unsigned char	*reg;
+
+	if( !strcmp(name,"pc") )	reg = &cpub->pc, max = 0xff;
+	else if( !strcmp(name,"acc") )	reg = &cpub->acc, max = 0xff;
+	else if( !strcmp(name,"ix") )	reg = &cpub->ix, max = 0xff;
+	else if( !strcmp(name,"cf") )	reg = &cpub->cf;
+	else if( !strcmp(name,"vf") )	reg = &cpub->vf;
+	else if( !strcmp(name,"nf") )	reg = &cpub->nf;
+	else if( !strcmp(name,"zf") )	reg = &cpub->zf;
+	else if( !strcmp(name,"ibuf") )	reg = &cpub->ibuf->buf, max = 0xff,
+					cpub->ibuf->flag = 1;
+	else if( !strcmp(name,"if") )	reg = &cpub->ibuf->flag;
+	else
+		return -1;
+
+	if( sscanf(strval,"%x",&value) != 1 || value > max )
+		return -1;
+	*reg = value;
+	return 0;
+}
+
+static int
+apply_snapshot(Cpub *cpub, const char *file)
+{
+	unsigned char	*buf;
+	size_t		size;
+
+	if( (buf = snap_read(file,&size)) == NULL )
+		return -1;
+	snap_decode_board(cpub,cpub->ibuf,buf + SNAP_HEADER);
+	free(buf);
+	return 0;
+}
+
+static int
+apply_setup(Cpub *cpub, const char *file)
+{
+#define	LINESIZE	160
+	FILE		*fp;
+	char		line[LINESIZE], cmd[LINESIZE];
+	char		arg1[LINESIZE], arg2[LINESIZE];
+	unsigned int	addr, value;
+	int		n, lineno = 0;
+
+	if( (fp = fopen(file,"r")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		return -1;
+	}
+	if( fread(line,1,8,fp) == 8 && !memcmp(line,SNAP_MAGIC,8) ) {
+		fclose(fp);
+		return apply_snapshot(cpub,file);
+	}
+	rewind(fp);
+	while( fgets(line,LINESIZE,fp) != NULL ) {
+		lineno++;
+		if( (n = sscanf(line,"%s%s%s",cmd,arg1,arg2)) <= 0
+		 || cmd[0] == '#' )
+			continue;
+
+		if( !strcmp(cmd,"r") && n == 2 ) {
+			if( read_mem_file(cpub,arg1) != 0 )
+				goto error;
+		} else
+		if( (!strcmp(cmd,"w") || !strcmp(cmd,"sm")) && n == 3 ) {
+			if( sscanf(arg1,"%x",&addr) != 1 || addr >= MEMORY_SIZE
+			 || sscanf(arg2,"%x",&value) != 1 || value > 0xff )
+				goto bad;
+			cpub->mem[addr] = value;
+		} else
+		if( !strcmp(cmd,"s") && n == 3 ) {
+			if( set_register(cpub,arg1,arg2) != 0 )
+				goto bad;
+		} else
+		if( !strcmp(cmd,"q") ) {
+			break;
+		} else
+		if( strcmp(cmd,"d") && strcmp(cmd,"m") && strcmp(cmd,"c")
+		 && strcmp(cmd,"h") && strcmp(cmd,"?") ) {
+			goto bad;
+		}
+	}
+	fclose(fp);
+	return 0;
+
+     bad:
+	fprintf(stderr,"%s:%d: bad setup command: %s",file,lineno,line);
+     error:
+	fclose(fp);
+	return -1;
+}
+
+
+/*=============================================================================
+ *   Write the Final State of a Job
+ *===========================================================================*/
+static void
+put_string(const char *s)
+{
+	putc('"',out);
+	for( ; *s != '\0' ; s++ ) {
+		if( *s == '"' || *s == '\\' )
+			fprintf(out,"\\%c",*s);
+		else if( (unsigned char)*s < 0x20 )
+			fprintf(out,"\\u%04x",*s);
+		else
+			putc(*s,out);
+	}
+	putc('"',out);
+}
+
+static void
+put_result(const Job *job)
+{
+	static const char	hex[] = "0123456789abcdef";
+	unsigned char		rec[BATCH_RECORD];
+	char			mem[2*MEMORY_SIZE + 1];
+	int			i;
+
+	if( binary ) {
+		memset(rec,0,16);
+		rec[0] = job->status;
+		rec[1] = job->pc;
+		rec[2] = job->acc;
+		rec[3] = job->ix;
+		rec[4] = job->flags;
+		rec[5] = job->obuf;
+		for( i = 0 ; i < 8 ; i++ )
+			rec[8+i] = (unsigned char)(job->count >> (8*i));
+		memcpy(rec + 16,job->mem,MEMORY_SIZE);
+		fwrite(rec,1,sizeof(rec),out);
+		return;
+	}
+
+	for( i = 0 ; i < MEMORY_SIZE ; i++ ) {
+		mem[2*i] = hex[job->mem[i] >> 4];
+		mem[2*i+1] = hex[job->mem[i] & 0xf];
+	}
+	mem[2*MEMORY_SIZE] = '\0';
+
+	fputs("{\"program\":",out);
+	put_string(job->program);
+	fputs(",\"setup\":",out);
+	if( job->setup != NULL )
+		put_string(job->setup);
+	else
+		fputs("null",out);
+	fprintf(out,",\"status\":\"%s\",\"count\":%llu,\"pc\":%d,\"acc\":%d,"
+			"\"ix\":%d,\"cf\":%d,\"vf\":%d,\"nf\":%d,\"zf\":%d,"
+			"\"obuf\":%d,\"mem\":\"%s\"}\n",
+			status_names[job->status],job->count,job->pc,job->acc,
+			job->ix,job->flags >> 3,(job->flags >> 2) & 1,
+			(job->flags >> 1) & 1,job->flags & 1,job->obuf,mem);
+}
+
+
+/*=============================================================================
+ *   Job Table
+ *===========================================================================*/
+static int
+add_job(const char *program, const char *setup)
+{
+	Job	*p;
+
+	if( njobs == maxjobs ) {
+		maxjobs = maxjobs ? 2 * maxjobs : 64;
+		if( (p = realloc(jobs,maxjobs * sizeof(Job))) == NULL ) {
+			fprintf(stderr,"Too many jobs\n");
+			return -1;
+		}
+		jobs = p;
+	}
+	p = &jobs[njobs++];
+	memset(p,0,sizeof(*p));
+	p->program = strdup(program);
+	p->setup = setup != NULL ? strdup(setup) : NULL;
+	p->status = JOB_ERROR;
+	return 0;
+}
+
+static int
+read_job_file(const char *file)
+{
+	FILE	*fp;
+	char	line[LINESIZE], program[LINESIZE], setup[LINESIZE];
+	int	n, result = 0;
+
+	if( (fp = fopen(file,"r")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		return -1;
+	}
+	while( result == 0 && fgets(line,LINESIZE,fp) != NULL ) {
+		if( (n = sscanf(line,"%s%s",program,setup)) <= 0
+		 || program[0] == '#' )
+			continue;
+		result = add_job(program,n == 2 ? setup : NULL);
+	}
+	fclose(fp);
+	return result;
+}
+
+
+/*=============================================================================
+ *   Worker Threads
+ *===========================================================================*/
+/* clear the board of a worker and set up a job on it */
+static int
+load_job(Worker *w, Job *job)
+{
+	Cpub	*cpub = &w->board;
+
+	reset_board(cpub,&w->input);
+	if( (strcmp(job->program,"-") && read_mem_file(cpub,job->program) != 0)
+	 || (job->setup != NULL && apply_setup(cpub,job->setup) != 0) ) {
+		fprintf(stderr,"%s: not run\n",job->program);
+		job->status = JOB_ERROR;
+		return -1;
+	}
+	return 0;
+}
+
+/* record the final state of a job */
+static void
+save_job(Job *job, const Cpub *cpub)
+{
+	job->pc = cpub->pc;
+	job->acc = cpub->acc;
+	job->ix = cpub->ix;
+	job->flags = (cpub->cf << 3) | (cpub->vf << 2)
+					| (cpub->nf << 1) | cpub->zf;
+	job->obuf = cpub->obuf.buf;
+	memcpy(job->mem,cpub->mem,MEMORY_SIZE);
+}
+
+static void
+run_job(Worker *w, Job *job)
+{
+	if( load_job(w,job) == 0 ) {
+		job->status = run(&w->board,limit,&job->count) == RUN_HALT
+						? JOB_HALT : JOB_LIMIT;
+		w->total += job->count;
+	}
+	save_job(job,&w->board);
+}
+
+/* next job of a worker, stolen if need be; -1 when all have been taken */
+static int
+take_job(Worker *w)
+{
+	Worker	*v;
+	int	i, job = -1, mid, end = 0;
+
+	pthread_mutex_lock(&w->lock);
+	if( w->next < w->end )
+		job = w->next++;
+	pthread_mutex_unlock(&w->lock);
+	if( job >= 0 )
+		return job;
+
+	for( i = 1 ; i < nworkers && job < 0 ; i++ ) {
+		v = &workers[(w - workers + i) % nworkers];
+		pthread_mutex_lock(&v->lock);
+		if( v->next < v->end ) {
+			mid = v->next + (v->end - v->next) / 2;
+			job = mid;
+			end = v->end;
+			v->end = mid;
+		}
+		pthread_mutex_unlock(&v->lock);
+	}
+	if( job >= 0 ) {
+		pthread_mutex_lock(&w->lock);
+		w->next = job + 1;
+		w->end = end;
+		pthread_mutex_unlock(&w->lock);
+	}
+	return job;
+}
+
+/*
+ *   Run up to LANES_GROUP jobs of a worker together in the lanes of
+ *   run_lanes(); each lane stops at limit, as a job run alone would
+ */
+static void
+run_lanes_jobs(Worker *w)
+{
+	int	lane[LANES_GROUP];
+	int	i, n, job;
+
+	do {
+		for( n = 0 ; n < LANES_GROUP && (job = take_job(w)) >= 0 ; ) {
+			if( load_job(w,&jobs[job]) != 0 ) {
+				save_job(&jobs[job],&w->board);
+				continue;
+			}
+			lanes_load(w->lanes,n,&w->board);
+			lane[n++] = job;
+		}
+		for( i = n ; i < w->lanes->n ; i++ )
+			w->lanes->live[i] = 0;	/* unused lanes */
+		if( n == 0 )
+			break;
+
+		run_lanes(w->lanes,limit,NULL);
+		for( i = 0 ; i < n ; i++ ) {
+			Job	*jp = &jobs[lane[i]];
+
+			reset_board(&w->board,&w->input);
+			lanes_store(w->lanes,i,&w->board);
+			jp->status = w->lanes->live[i] ? JOB_LIMIT : JOB_HALT;
+			jp->count = w->lanes->count[i];
+			w->total += jp->count;
+			save_job(jp,&w->board);
+		}
+	} while( job >= 0 );
+}
+
+static void *
+worker_main(void *arg)
+{
+	Worker	*w = arg;
+	int	job;
+
+	if( w->lanes != NULL ) {
+		run_lanes_jobs(w);
+		return NULL;
+	}
+	while( (job = take_job(w)) >= 0 )
+		run_job(w,&jobs[job]);
+	return NULL;
+}
+
+/* run all jobs on nthreads workers (nthreads <= njobs) */
+static int
+run_jobs(int nthreads)
+{
+	int	i;
+
+	if( (workers = calloc(nthreads,sizeof(Worker))) == NULL ) {
+		fprintf(stderr,"Unable to allocate %d workers\n",nthreads);
+		return -1;
+	}
+	nworkers = nthreads;
+	for( i = 0 ; i < nworkers ; i++ ) {
+		pthread_mutex_init(&workers[i].lock,NULL);
+		if( run == NULL
+		 && (workers[i].lanes = lanes_new(LANES_GROUP)) == NULL ) {
+			fprintf(stderr,"Unable to allocate the lanes\n");
+			return -1;
+		}
+		workers[i].next = (long)njobs * i / nworkers;
+		workers[i].end = (long)njobs * (i + 1) / nworkers;
+	}
+
+	for( i = 1 ; i < nworkers ; i++ )
+		if( pthread_create(&workers[i].thread,NULL,worker_main,
+							&workers[i]) != 0 ) {
+			fprintf(stderr,"Unable to start a worker thread\n");
+			break;		/* the others steal its jobs */
+		}
+	nthreads = i;
+	worker_main(&workers[0]);
+	for( i = 1 ; i < nthreads ; i++ )
+		pthread_join(workers[i].thread,NULL);
+	return 0;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	const char		*jobfile = NULL, *outfile = NULL;
+	struct timespec		t0, t1;
+	unsigned long long	total;
+	char			*setup;
+	long			nthreads = 0;
+	int			c, i, fd, nhalted;
+
+	while( (c = getopt(argc,argv,"e:l:f:o:j:t:")) != -1 ) {
+		switch( c ) {
+		   case 'e':
+			for( i = 0 ; i < NENGINES ; i++ )
+				if( !strcmp(optarg,engines[i].name) )
+					break;
+			if( i == NENGINES ) {
+				fprintf(stderr,"Unknown engine: %s\n",optarg);
+				return 2;
+			}
+			run = engines[i].run;
+			break;
+		   case 'l':
+			if( (limit = strtoull(optarg,NULL,0)) == 0 )
+				limit = ~0ULL;
+			break;
+		   case 'f':
+			if( !strcmp(optarg,"bin") )
+				binary = 1;
+			else if( !strcmp(optarg,"json") )
+				binary = 0;
+			else {
+				usage(argv[0]);
+				return 2;
+			}
+			break;
+		   case 'o':
+			outfile = optarg;
+			break;
+		   case 'j':
+			jobfile = optarg;
+			break;
+		   case 't':
+			nthreads = strtol(optarg,NULL,0);
+			break;
+		   default:
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if( jobfile != NULL && read_job_file(jobfile) != 0 )
+		return 2;
+	for( i = optind ; i < argc ; i++ ) {
+		if( (setup = strchr(argv[i],',')) != NULL )
+			*setup++ = '\0';
+		if( add_job(argv[i],setup) != 0 )
+			return 2;
+	}
+	if( njobs == 0 ) {
+		usage(argv[0]);
+		return 2;
+	}
+	if( nthreads <= 0 && (nthreads = sysconf(_SC_NPROCESSORS_ONLN)) <= 0 )
+		nthreads = 1;
+	if( nthreads > njobs )
+		nthreads = njobs;
+
+	/*
+	 *   The results go to the output file or the standard output;
+	 *   messages of step() ("HLT instruction executed") are moved from
+	 *   the standard output to the standard error in the latter case
+	 */
+	if( outfile != NULL ) {
+		if( (out = fopen(outfile,binary ? "wb" : "w")) == NULL ) {
+			fprintf(stderr,"Unable to open %s\n",outfile);
+			return 2;
+		}
+	} else {
+		fflush(stdout);
+		if( (fd = dup(STDOUT_FILENO)) < 0
+		 || (out = fdopen(fd,binary ? "wb" : "w")) == NULL
+		 || dup2(STDERR_FILENO,STDOUT_FILENO) < 0 ) {
+			perror("cpu_sim_batch");
+			return 2;
+		}
+	}
+
+	/*
+	 *   Run the jobs (the engines are prepared before the threads start)
+	 */
+	init_decode_table();
+	run_threaded(NULL,0,NULL);
+	run_block(NULL,0,NULL);
+	clock_gettime(CLOCK_MONOTONIC,&t0);
+	if( run_jobs((int)nthreads) != 0 )
+		return 2;
+	clock_gettime(CLOCK_MONOTONIC,&t1);
+
+	/*
+	 *   Write the results
+	 */
+	setvbuf(out,NULL,_IOFBF,1 << 16);
+	if( binary )
+		fwrite(BATCH_MAGIC,1,8,out);
+	for( i = nhalted = 0 ; i < njobs ; i++ ) {
+		put_result(&jobs[i]);
+		if( jobs[i].status == JOB_HALT )
+			nhalted++;
+	}
+	if( fclose(out) != 0 ) {
+		perror("cpu_sim_batch");
+		return 2;
+	}
+
+	for( i = 0, total = 0 ; i < nworkers ; i++ )
+		total += workers[i].total;
+	fprintf(stderr,"%d jobs, %d halted, %llu instructions in %.3f sec "
+			"(%d threads)\n",njobs,nhalted,total,
+			(double)(t1.tv_sec - t0.tv_sec)
+				+ (t1.tv_nsec - t0.tv_nsec) * 1e-9,nworkers);
+	return nhalted == njobs ? 0 : 1;
+}
@@ -0,0 +1,485 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	bench.c
+ *	Descrioption:	throughput benchmark of the execution engines
+ */
+
+#define	_POSIX_C_SOURCE	200809L	/* clock_gettime(), getopt(), dup() */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<time.h>
+#include	<fcntl.h>
+#include	<unistd.h>
+#include	"cpuboard.h"
+#include	"block.h"
+#include	"loader.h"
+
+
+/*=============================================================================
+ *   Main Routine: cpu_sim_bench [options] [program ...]
+ *
+ *	-e engines	engines to measure, separated by commas (default
+ *			step,threaded,block,jit)
+ *	-r reps		timed repetitions of a measurement (default 5)
+ *	-n count	instructions of a repetition (default 20000000)
+ *	-b file		baseline to compare with
+ *	-s file		save the results as a baseline
+ *	-t percent	drop of MIPS from the baseline taken as a regression
+ *			(default 10)
+ *
+ *   A program is a file in the format of 'r' or one of the kernels
+ *   @alu, @branch and @memory below.  Without programs the kernels,
+ *   test/sample_program.txt and test/multi_precision_complete.txt are
+ *   measured (the files only if they are found).
+ *
+ *   A repetition reloads the program and runs it to HLT over and over
+ *   until count instructions have run, so the time of a short program
+ *   includes reloading it.  Every measurement is preceded by an untimed
+ *   run whose final state must equal that of step(); the median, min and
+ *   max over the repetitions are reported.
+ *
+ *   A baseline holds one "program engine MIPS" line per measurement.
+ *   Exits with 0, 1 if an engine disagrees with step() or a median is
+ *   below the baseline by more than the threshold, and 2 on a usage error.
+ *===========================================================================*/
+#define	BENCH_REPS	5
+#define	BENCH_COUNT	20000000ULL
+#define	BENCH_DROP	10.0		/* % */
+#define	BENCH_MAXREPS	101
+#define	NAMESIZE	160
+
+static const struct {
+	const char	*name;
+	RunEngine	*run;
+} engines[] = {
+	{ "step",	run_step },
+	{ "threaded",	run_threaded },
+	{ "block",	run_block },
+	{ "jit",	run_jit },
+};
+#define	NENGINES	(int)(sizeof(engines)/sizeof(engines[0]))
+
+
+/*=============================================================================
+ *   Synthetic Kernels (256 x 256 iterations, about 0.5M instructions)
+ *===========================================================================*/
+static const Uword	kernel_alu[] = {
+	0x6A, 0x00,		/* 00:	LD	IX,0		*/
+	0x62, 0x00,		/* 02:	LD	ACC,0		*/
+	0xB2, 0x03,		/* 04:	ADD	ACC,3		*/
+	0xC2, 0x5A,		/* 06:	EOR	ACC,5A		*/
+	0xA2, 0x01,		/* 08:	SUB	ACC,1		*/
+	0xE2, 0x7F,		/* 0A:	AND	ACC,7F		*/
+	0xD2, 0x01,		/* 0C:	OR	ACC,1		*/
+	0xC1,			/* 0E:	EOR	ACC,IX		*/
+	0xBA, 0x01,		/* 0F:	ADD	IX,1		*/
+	0x31, 0x04,		/* 11:	BNZ	04		*/
+	0x65, 0x00,		/* 13:	LD	ACC,(00)	*/
+	0xB2, 0x01,		/* 15:	ADD	ACC,1		*/
+	0x75, 0x00,		/* 17:	ST	ACC,(00)	*/
+	0x31, 0x02,		/* 19:	BNZ	02		*/
+	0x0F			/* 1B:	HLT			*/
+};
+
+static const Uword	kernel_branch[] = {
+	0x6A, 0x00,		/* 00:	LD	IX,0		*/
+	0xFA, 0x40,		/* 02:	CMP	IX,40		*/
+	0x3E, 0x08,		/* 04:	BLT	08		*/
+	0x30, 0x08,		/* 06:	BA	08		*/
+	0xFA, 0xC0,		/* 08:	CMP	IX,C0		*/
+	0x37, 0x0E,		/* 0A:	BGT	0E		*/
+	0x30, 0x0E,		/* 0C:	BA	0E		*/
+	0x61,			/* 0E:	LD	ACC,IX		*/
+	0xE2, 0x01,		/* 0F:	AND	ACC,1		*/
+	0x39, 0x15,		/* 11:	BZ	15		*/
+	0x30, 0x15,		/* 13:	BA	15		*/
+	0xBA, 0x01,		/* 15:	ADD	IX,1		*/
+	0x31, 0x02,		/* 17:	BNZ	02		*/
+	0x65, 0x00,		/* 19:	LD	ACC,(00)	*/
+	0xB2, 0x01,		/* 1B:	ADD	ACC,1		*/
+	0x75, 0x00,		/* 1D:	ST	ACC,(00)	*/
+	0x31, 0x02,		/* 1F:	BNZ	02		*/
+	0x0F			/* 21:	HLT			*/
+};
+
+static const Uword	kernel_memory[] = {
+	0x6A, 0x00,		/* 00:	LD	IX,0		*/
+	0x67, 0x00,		/* 02:	LD	ACC,(IX+00)	*/
+	0xB2, 0x01,		/* 04:	ADD	ACC,1		*/
+	0x77, 0x00,		/* 06:	ST	ACC,(IX+00)	*/
+	0xB7, 0x80,		/* 08:	ADD	ACC,(IX+80)	*/
+	0x77, 0x80,		/* 0A:	ST	ACC,(IX+80)	*/
+	0x66, 0x00,		/* 0C:	LD	ACC,[IX+00]	*/
+	0xBA, 0x01,		/* 0E:	ADD	IX,1		*/
+	0x31, 0x02,		/* 10:	BNZ	02		*/
+	0x64, 0xF0,		/* 12:	LD	ACC,[F0]	*/
+	0xB2, 0x01,		/* 14:	ADD	ACC,1		*/
+	0x74, 0xF0,		/* 16:	ST	ACC,[F0]	*/
+	0x31, 0x02,		/* 18:	BNZ	02		*/
+	0x0F			/* 1A:	HLT			*/
+};
+
+static const struct {
+	const char	*name;
+	const Uword	*words;
+	size_t		n;
+} kernels[] = {
+	{ "@alu",	kernel_alu,	sizeof(kernel_alu) },
+	{ "@branch",	kernel_branch,	sizeof(kernel_branch) },
+	{ "@memory",	kernel_memory,	sizeof(kernel_memory) },
+};
+#define	NKERNELS	(int)(sizeof(kernels)/sizeof(kernels[0]))
+
+static const char	*default_files[] = {
+	"test/sample_program.txt", "test/multi_precision_complete.txt"
+};
+
+
+/*=============================================================================
+ *   Programs and Baseline
+ *===========================================================================*/
+typedef struct program {
+	char	name[NAMESIZE];
+	Uword	image[MEMORY_SIZE];	/* memory when loaded */
+} Program;
+
+typedef struct baseline {
+	char	program[NAMESIZE], engine[NAMESIZE];
+	double	mips;
+} Baseline;
+
+static Program		*programs;
+static int		nprograms;
+static Baseline		*base;
+static int		nbase;
+
+static Cpub		board;
+static IOBuf		input;
+static FILE		*out;
+
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr,"usage: %s [-e engines] [-r reps] [-n count] "
+			"[-b file] [-s file] [-t percent] [program ...]\n",
+			prog);
+}
+
+
+static Program *
+new_program(const char *name)
+{
+	Program	*p;
+
+	if( (p = realloc(programs,(nprograms + 1) * sizeof(Program))) == NULL )
+		return NULL;
+	programs = p;
+	p = &programs[nprograms++];
+	memset(p,0,sizeof(*p));
+	snprintf(p->name,NAMESIZE,"%s",name);
+	return p;
+}
+
+/* a kernel (@name) or a program file; -1 if neither */
+static int
+add_program(const char *name)
+{
+	static Cpub	temp;
+	Program		*p;
+	int		i;
+
+	for( i = 0 ; i < NKERNELS && strcmp(name,kernels[i].name) ; i++ )
+		;
+	if( i == NKERNELS ) {
+		memset(&temp,0,sizeof(temp));
+		if( read_mem_file(&temp,name) != 0 )
+			return -1;
+	}
+	if( (p = new_program(name)) == NULL ) {
+		fprintf(stderr,"Too many programs\n");
+		return -1;
+	}
+	if( i < NKERNELS )
+		memcpy(p->image,kernels[i].words,kernels[i].n);
+	else
+		memcpy(p->image,temp.mem,MEMORY_SIZE);
+	return 0;
+}
+
+
+static int
+read_baseline(const char *file)
+{
+	FILE		*fp;
+	Baseline	b, *p;
+
+	if( (fp = fopen(file,"r")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		return -1;
+	}
+	while( fscanf(fp,"%159s %159s %lf",b.program,b.engine,&b.mips) == 3 ) {
+		if( (p = realloc(base,(nbase + 1) * sizeof(Baseline))) == NULL )
+			break;
+		base = p;
+		base[nbase++] = b;
+	}
+	fclose(fp);
+	return 0;
+}
+
+static const Baseline *
+find_baseline(const char *program, const char *engine)
+{
+	int	i;
+
+	for( i = 0 ; i < nbase ; i++ )
+		if( !strcmp(base[i].program,program)
+		 && !strcmp(base[i].engine,engine) )
+			return &base[i];
+	return NULL;
+}
+
+
+/*=============================================================================
+ *   Runs
+ *===========================================================================*/
+/*
+ *   Put the board back to the loaded program (translations of unchanged
+ *   program words stay)
+ */
+static void
+load_program(const Program *p)
+{
+	int	addr;
+
+	for( addr = 0 ; addr < IMEMORY_SIZE ; addr++ )
+		if( board.mem[addr] != p->image[addr] ) {
+			board.mem[addr] = p->image[addr];
+			CodeWrite(&board,addr);
+		}
+	memcpy(board.mem + IMEMORY_SIZE,p->image + IMEMORY_SIZE,
+					MEMORY_SIZE - IMEMORY_SIZE);
+	board.pc = board.acc = board.ix = 0;
+	board.cf = board.vf = board.nf = board.zf = 0;
+	board.flag_op = FLAGS_VALID;
+	board.obuf.flag = board.obuf.buf = 0;
+	memset(&input,0,sizeof(input));
+	board.ibuf = &input;
+}
+
+/* run the program once (at most limit instructions); its final state */
+static unsigned long long
+run_once(const Program *p, RunEngine *run, unsigned long long limit,
+								Cpub *final)
+{
+	unsigned long long	n;
+
+	load_program(p);
+	run(&board,limit,&n);
+	*final = board;
+	return n;
+}
+
+static int
+same_state(const Cpub *a, const Cpub *b)
+{
+	return a->pc == b->pc && a->acc == b->acc && a->ix == b->ix
+	    && a->cf == b->cf && a->vf == b->vf && a->nf == b->nf
+	    && a->zf == b->zf && a->obuf.flag == b->obuf.flag
+	    && a->obuf.buf == b->obuf.buf
+	    && !memcmp(a->mem,b->mem,MEMORY_SIZE);
+}
+
+/* time one repetition: seconds for count instructions or more */
+static double
+repetition(const Program *p, RunEngine *run, unsigned long long count,
+						unsigned long long *total)
+{
+	struct timespec		t0, t1;
+	unsigned long long	n;
+
+	clock_gettime(CLOCK_MONOTONIC,&t0);
+	for( *total = 0 ; *total < count ; *total += n ) {
+		load_program(p);
+		run(&board,count - *total,&n);
+	}
+	clock_gettime(CLOCK_MONOTONIC,&t1);
+	return (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+}
+
+static int
+compare_double(const void *a, const void *b)
+{
+	double	x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+
+/*
+ *   Measure a program on an engine; 1 if it disagrees with step() or
+ *   falls below the baseline
+ */
+static int
+measure(const Program *p, int e, int reps, unsigned long long count,
+				double drop, FILE *save)
+{
+	static Cpub		expect, final;
+	const Baseline		*b;
+	double			mips[BENCH_MAXREPS], sec, median;
+	unsigned long long	n, m, total;
+	int			i, failed = 0;
+
+	n = run_once(p,run_step,count,&expect);
+	m = run_once(p,engines[e].run,count,&final);
+	fprintf(out,"%-36s %-9s",p->name,engines[e].name);
+	if( n != m || !same_state(&expect,&final) ) {
+		fprintf(out," MISMATCH with step() (%llu/%llu instructions, "
+			"PC=0x%02x/0x%02x)\n",m,n,final.pc,expect.pc);
+		return 1;
+	}
+
+	for( i = 0 ; i < reps ; i++ ) {
+		sec = repetition(p,engines[e].run,count,&total);
+		mips[i] = sec > 0 ? total / sec / 1e6 : 0;
+	}
+	qsort(mips,reps,sizeof(double),compare_double);
+	median = (reps & 1) ? mips[reps/2]
+			    : (mips[reps/2 - 1] + mips[reps/2]) / 2;
+
+	fprintf(out," %9.2f %9.2f %9.2f %9.2f",
+		median > 0 ? 1e3 / median : 0,median,mips[0],mips[reps-1]);
+	if( (b = find_baseline(p->name,engines[e].name)) != NULL ) {
+		fprintf(out," %9.2f %+6.1f%%",b->mips,
+			b->mips > 0 ? 100.0 * (median - b->mips) / b->mips : 0);
+		if( median < b->mips * (1 - drop / 100) ) {
+			fprintf(out," REGRESSION");
+			failed = 1;
+		}
+	}
+	fprintf(out,"\n");
+	fflush(out);
+	if( save != NULL )
+		fprintf(save,"%s %s %.2f\n",p->name,engines[e].name,median);
+	return failed;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	const char		*savefile = NULL;
+	char			list[NAMESIZE], *name;
+	unsigned long long	count = BENCH_COUNT;
+	double			drop = BENCH_DROP;
+	int			use[NENGINES];
+	int			reps = BENCH_REPS;
+	int			c, i, k, fd, failed = 0;
+	FILE			*save = NULL;
+
+	for( i = 0 ; i < NENGINES ; i++ )
+		use[i] = 1;
+	while( (c = getopt(argc,argv,"e:r:n:b:s:t:")) != -1 ) {
+		switch( c ) {
+		   case 'e':
+			memset(use,0,sizeof(use));
+			snprintf(list,NAMESIZE,"%s",optarg);
+			for( name = strtok(list,",") ; name != NULL ;
+						name = strtok(NULL,",") ) {
+				for( i = 0 ; i < NENGINES ; i++ )
+					if( !strcmp(name,engines[i].name) )
+						break;
+				if( i == NENGINES ) {
+					fprintf(stderr,"Unknown engine: %s\n",
+									name);
+					return 2;
+				}
+				use[i] = 1;
+			}
+			break;
+		   case 'r':
+			reps = atoi(optarg);
+			if( reps < 1 || reps > BENCH_MAXREPS ) {
+				usage(argv[0]);
+				return 2;
+			}
+			break;
+		   case 'n':
+			if( (count = strtoull(optarg,NULL,0)) == 0 ) {
+				usage(argv[0]);
+				return 2;
+			}
+			break;
+		   case 'b':
+			if( read_baseline(optarg) != 0 )
+				return 2;
+			break;
+		   case 's':
+			savefile = optarg;
+			break;
+		   case 't':
+			drop = atof(optarg);
+			break;
+		   default:
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	for( i = optind ; i < argc ; i++ )
+		if( add_program(argv[i]) != 0 ) {
+			fprintf(stderr,"Unable to load %s\n",argv[i]);
+			return 2;
+		}
+	if( optind == argc ) {
+		for( i = 0 ; i < NKERNELS ; i++ )
+			add_program(kernels[i].name);
+		for( i = 0 ; i < (int)(sizeof(default_files)/sizeof(char *)) ;
+									i++ )
+			if( access(default_files[i],R_OK) == 0 )
+				add_program(default_files[i]);
+	}
+	if( savefile != NULL && (save = fopen(savefile,"w")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",savefile);
+		return 2;
+	}
+
+	/*
+	 *   The report goes to the standard output; messages of step() ("HLT
+	 *   instruction executed", once a run) are thrown away
+	 */
+	fflush(stdout);
+	if( (fd = dup(STDOUT_FILENO)) < 0 || (out = fdopen(fd,"w")) == NULL
+	 || (fd = open("/dev/null",O_WRONLY)) < 0
+	 || dup2(fd,STDOUT_FILENO) < 0 ) {
+		perror("cpu_sim_bench");
+		return 2;
+	}
+	close(fd);
+
+	init_decode_table();
+	run_threaded(NULL,0,NULL);
+	run_block(NULL,0,NULL);
+
+	fprintf(out,"%-36s %-9s %9s %9s %9s %9s %9s\n","program","engine",
+			"ns/inst","MIPS","min","max","baseline");
+	for( k = 0 ; k < nprograms ; k++ )
+		for( i = 0 ; i < NENGINES ; i++ )
+			if( use[i] ) {
+				block_free(&board);
+				failed |= measure(&programs[k],i,reps,count,
+								drop,save);
+			}
+	block_free(&board);
+
+	if( save != NULL && fclose(save) != 0 ) {
+		perror("cpu_sim_bench");
+		return 2;
+	}
+	fclose(out);
+	return failed;
+}
@@ -0,0 +1,526 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	conform.c
+ *	Descrioption:	differential conformance check of the execution
+ *			engines and the other implementations of step()
+ */
+
+#define	_POSIX_C_SOURCE	200809L	/* getopt(), dup() */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<fcntl.h>
+#include	<unistd.h>
+#include	"cpuboard.h"
+#include	"loader.h"
+#include	"disasm.h"
+#include	"lanes.h"
+
+
+/*=============================================================================
+ *   Main Routine: cpu_sim_conform [options] [program ...]
+ *
+ *	-e engines	engines separated by commas; the first is the
+ *			reference the others are checked against (default
+ *			step,threaded,block,jit,lanes)
+ *	-r count	random programs (default 100)
+ *	-S seed		seed of the random programs (default 1)
+ *	-n count	instructions a program may run (default 100000)
+ *	-k count	instructions run between comparisons (default 256)
+ *
+ *   Engines are those of the simulator and the earlier implementations
+ *   of step() kept in the tree, built into this program under other
+ *   names (see CMakeLists.txt):
+ *
+ *	step threaded block jit	cpu-remove-comment.c and the engines
+ *	lanes			run_lanes() with the board in one lane
+ *	cpu			cpu.c
+ *	cpuboard		cpuboard.c
+ *	cpu-only-st		cpu-only-st.c
+ *
+ *   A program is a file in the format of 'r', run from PC 00 with
+ *   cleared registers, or a random one: every program word is an
+ *   instruction of decode_table, and memory, registers, flags and the
+ *   input buffer are random.  Without program files, those of test/ are
+ *   used if they are found.
+ *
+ *   Two engines run a program in lockstep, count instructions at a time,
+ *   until it halts or has run its instructions.  When their states
+ *   differ, both are put back to the last equal state and run one
+ *   instruction at a time to find the first one they disagree on; it is
+ *   reported with the state before it and the state after it of each
+ *   engine.  The state is PC, ACC, IX, the flags, the input and output
+ *   buffers, the memory and whether the engine halted.  block and jit
+ *   leave single instructions to threaded, so they may disagree only
+ *   when run count at a time; then the whole slice is reported (a
+ *   smaller -k narrows it).
+ *
+ *   Exits with 0 if every engine agrees with the reference, 1 if one
+ *   does not, and 2 on a usage error.
+ *===========================================================================*/
+#define	CONFORM_RANDOM	100
+#define	CONFORM_SEED	1
+#define	CONFORM_COUNT	100000ULL
+#define	CONFORM_CHUNK	256ULL
+#define	NAMESIZE	160
+
+/* the earlier step()s (renamed at compile time) */
+int	legacy_cpu_step(Cpub *);
+int	legacy_cpuboard_step(Cpub *);
+int	legacy_only_st_step(Cpub *);
+
+#define	LEGACY_ENGINE(name,step_func)					\
+static int								\
+name(Cpub *cpub, unsigned long long limit, unsigned long long *count)	\
+{									\
+	unsigned long long	n;					\
+	int			result = RUN_STEP;			\
+									\
+	for( n = 0 ; n < limit && result == RUN_STEP ; n++ )		\
+		result = step_func(cpub);				\
+	if( count != NULL )						\
+		*count = n;						\
+	return result;							\
+}
+
+LEGACY_ENGINE(run_legacy_cpu,legacy_cpu_step)
+LEGACY_ENGINE(run_legacy_cpuboard,legacy_cpuboard_step)
+LEGACY_ENGINE(run_legacy_only_st,legacy_only_st_step)
+
+/* run_lanes() on a board copied into its lane and back */
+static Lanes	*lanes;
+
+static int
+run_one_lane(Cpub *cpub, unsigned long long limit, unsigned long long *count)
+{
+	int	result;
+
+	FlagSync(cpub);
+	lanes_load(lanes,0,cpub);
+	result = run_lanes(lanes,limit,count);
+	lanes_store(lanes,0,cpub);
+	return result;
+}
+
+static const struct {
+	const char	*name;
+	RunEngine	*run;
+} engines[] = {
+	{ "step",		run_step },
+	{ "threaded",		run_threaded },
+	{ "block",		run_block },
+	{ "jit",		run_jit },
+	{ "lanes",		run_one_lane },
+	{ "cpu",		run_legacy_cpu },
+	{ "cpuboard",		run_legacy_cpuboard },
+	{ "cpu-only-st",	run_legacy_only_st },
+};
+#define	NENGINES	(int)(sizeof(engines)/sizeof(engines[0]))
+
+static const char	*default_files[] = {
+	"test/sample_program.txt", "test/multi_precision_complete.txt",
+	"test/st_test.txt"
+};
+
+
+/*=============================================================================
+ *   Programs
+ *===========================================================================*/
+typedef struct program {
+	char	name[NAMESIZE];
+	Cpub	init;			/* state when loaded */
+	IOBuf	input;
+} Program;
+
+static Program		*programs;
+static int		nprograms;
+static FILE		*out;
+
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr,"usage: %s [-e engines] [-r count] [-S seed] "
+			"[-n count] [-k count] [program ...]\n",prog);
+}
+
+
+static Program *
+new_program(void)
+{
+	Program	*p;
+
+	if( (p = realloc(programs,(nprograms + 1) * sizeof(Program))) == NULL )
+		return NULL;
+	programs = p;
+	p = &programs[nprograms++];
+	memset(p,0,sizeof(*p));
+	return p;
+}
+
+static int
+add_file(const char *file)
+{
+	Program	*p;
+
+	if( (p = new_program()) == NULL ) {
+		fprintf(stderr,"Too many programs\n");
+		return -1;
+	}
+	snprintf(p->name,NAMESIZE,"%s",file);
+	if( read_mem_file(&p->init,file) != 0 ) {
+		nprograms--;
+		return -1;
+	}
+	return 0;
+}
+
+
+/*
+ *   Random programs (xorshift, so that a seed gives the same programs
+ *   everywhere)
+ */
+static unsigned long	rand_state;
+
+static Uword
+rand_word(void)
+{
+	rand_state ^= (rand_state << 13) & 0xffffffffUL;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= (rand_state << 5) & 0xffffffffUL;
+	return (Uword)(rand_state >> 8);
+}
+
+static int
+add_random(int k, unsigned long seed)
+{
+	static Uword	valid[256];
+	static int	nvalid = 0;
+	const InstructionInfo	*e;
+	Program		*p;
+	Cpub		*c;
+	int		w, addr;
+
+	if( nvalid == 0 )
+		for( w = 0 ; w < 256 ; w++ ) {
+			e = &decode_table[w];
+			if( e->type != INST_UNKNOWN
+			 && !(e->type >= INST_LD && e->type <= INST_EOR
+			      && e->addr_mode_b == ADDR_MODE_NONE) )
+				valid[nvalid++] = (Uword)w;
+		}
+	if( (p = new_program()) == NULL ) {
+		fprintf(stderr,"Too many programs\n");
+		return -1;
+	}
+	snprintf(p->name,NAMESIZE,"random %d (seed %lu)",k,seed);
+	rand_state = ((seed * 2654435761UL + (unsigned long)k * 40503UL)
+						& 0xffffffffUL) | 1UL;
+	c = &p->init;
+	for( addr = 0 ; addr < IMEMORY_SIZE ; addr++ ) {
+		w = valid[rand_word() % nvalid];
+		c->mem[addr] = (Uword)w;
+		if( decode_table[w].word_length == 2
+		 && addr + 1 < IMEMORY_SIZE )
+			c->mem[++addr] = rand_word();
+	}
+	for( ; addr < MEMORY_SIZE ; addr++ )
+		c->mem[addr] = rand_word();
+	c->pc = rand_word();
+	c->acc = rand_word();
+	c->ix = rand_word();
+	w = rand_word();
+	c->cf = w & 1; c->vf = (w >> 1) & 1; c->nf = (w >> 2) & 1;
+	c->zf = (w >> 3) & 1;
+	p->input.buf = rand_word();
+	p->input.flag = rand_word() & 1;
+	return 0;
+}
+
+
+/*=============================================================================
+ *   Boards
+ *===========================================================================*/
+typedef struct board {
+	Cpub	cpub;
+	IOBuf	input;
+	int	halted;
+} Board;
+
+/*
+ *   Put a board into a state; translations of unchanged program words
+ *   stay, the others are dropped through CodeWrite()
+ */
+static void
+set_state(Board *b, const Cpub *s, const IOBuf *input, int halted)
+{
+	Cpub	*c = &b->cpub;
+	int	addr;
+
+	for( addr = 0 ; addr < IMEMORY_SIZE ; addr++ )
+		if( c->mem[addr] != s->mem[addr] ) {
+			c->mem[addr] = s->mem[addr];
+			CodeWrite(c,addr);
+		}
+	memcpy(c->mem + IMEMORY_SIZE,s->mem + IMEMORY_SIZE,
+					MEMORY_SIZE - IMEMORY_SIZE);
+	c->pc = s->pc; c->acc = s->acc; c->ix = s->ix;
+	c->cf = s->cf; c->vf = s->vf; c->nf = s->nf; c->zf = s->zf;
+	c->flag_op = FLAGS_VALID;
+	c->obuf.buf = s->obuf.buf;
+	c->obuf.flag = s->obuf.flag;
+	b->input = *input;
+	c->ibuf = &b->input;
+	b->halted = halted;
+}
+
+#define	restore(b,s)	set_state((b),&(s)->cpub,&(s)->input,(s)->halted)
+
+static void
+run_board(Board *b, RunEngine *run, unsigned long long limit,
+						unsigned long long *n)
+{
+	*n = 0;
+	if( !b->halted && limit > 0 )
+		b->halted = run(&b->cpub,limit,n) == RUN_HALT;
+	FlagSync(&b->cpub);
+}
+
+static int
+same_state(const Board *a, const Board *b)
+{
+	const Cpub	*x = &a->cpub, *y = &b->cpub;
+
+	return a->halted == b->halted
+	    && x->pc == y->pc && x->acc == y->acc && x->ix == y->ix
+	    && x->cf == y->cf && x->vf == y->vf && x->nf == y->nf
+	    && x->zf == y->zf && x->obuf.flag == y->obuf.flag
+	    && x->obuf.buf == y->obuf.buf && a->input.flag == b->input.flag
+	    && !memcmp(x->mem,y->mem,MEMORY_SIZE);
+}
+
+
+/*=============================================================================
+ *   Report of a Divergence
+ *===========================================================================*/
+static void
+print_state(const char *name, const Board *b)
+{
+	const Cpub	*c = &b->cpub;
+
+	fprintf(out,"\t%-12s pc=0x%02x acc=0x%02x ix=0x%02x "
+		"cf=%d vf=%d nf=%d zf=%d obuf=%d:0x%02x%s\n",name,c->pc,
+		c->acc,c->ix,c->cf,c->vf,c->nf,c->zf,c->obuf.flag,
+		c->obuf.buf,b->halted ? " halted" : "");
+}
+
+static void
+report(const Program *p, int ref, int e, unsigned long long at,
+		unsigned long long n, const Board *before, const Board *a,
+		const Board *b)
+{
+	const Cpub	*c = &before->cpub;
+	char		text[DISASM_TEXT];
+	int		len, addr;
+
+	len = disasm(c->mem,c->pc,text,sizeof(text));
+	if( n == 1 )
+		fprintf(out,"%s: %s and %s diverge at instruction %llu\n",
+			p->name,engines[ref].name,engines[e].name,at);
+	else
+		fprintf(out,"%s: %s and %s diverge within instructions "
+			"%llu-%llu\n",p->name,engines[ref].name,
+			engines[e].name,at,at + n - 1);
+	fprintf(out,"\t%02x:  %02x",c->pc,c->mem[c->pc]);
+	if( len == 2 )
+		fprintf(out," %02x",c->mem[(c->pc + 1) & 0xff]);
+	else
+		fprintf(out,"   ");
+	fprintf(out,"\t%s\n",text);
+	print_state("before",before);
+	print_state(engines[ref].name,a);
+	print_state(engines[e].name,b);
+	for( addr = 0 ; addr < MEMORY_SIZE ; addr++ )
+		if( a->cpub.mem[addr] != b->cpub.mem[addr] )
+			fprintf(out,"\tmem[0x%03x]   0x%02x / 0x%02x "
+				"(was 0x%02x)\n",addr,a->cpub.mem[addr],
+				b->cpub.mem[addr],c->mem[addr]);
+}
+
+
+/*=============================================================================
+ *   Lockstep Run of Two Engines
+ *===========================================================================*/
+static Board	board_a, board_b, saved, first;
+
+/*
+ *   Run a program on the reference and another engine; 0 if they agree,
+ *   1 after reporting the first instruction they disagree on.  *total is
+ *   what the reference ran.
+ */
+static int
+lockstep(const Program *p, int ref, int e, unsigned long long count,
+		unsigned long long chunk, unsigned long long *total)
+{
+	unsigned long long	done, na, nb, slice, i;
+
+	set_state(&board_a,&p->init,&p->input,0);
+	set_state(&board_b,&p->init,&p->input,0);
+	for( done = 0 ; done < count && !board_a.halted ; done += na ) {
+		saved = first = board_a;
+		slice = (count - done < chunk) ? count - done : chunk;
+		run_board(&board_a,engines[ref].run,slice,&na);
+		run_board(&board_b,engines[e].run,slice,&nb);
+		if( na == nb && same_state(&board_a,&board_b) )
+			continue;
+
+		/* back to the last equal state, then one at a time */
+		for( i = 0 ; i < slice ; i++ ) {
+			restore(&board_a,&saved);
+			restore(&board_b,&saved);
+			run_board(&board_a,engines[ref].run,1,&na);
+			run_board(&board_b,engines[e].run,1,&nb);
+			if( na != nb || !same_state(&board_a,&board_b) )
+				break;
+			saved = board_a;
+		}
+		if( i < slice ) {
+			report(p,ref,e,done + i + 1,1,&saved,&board_a,&board_b);
+			*total = done + i + 1;
+			return 1;
+		}
+
+		/* only when run count at a time: report the whole slice */
+		restore(&board_a,&first);
+		restore(&board_b,&first);
+		run_board(&board_a,engines[ref].run,slice,&na);
+		run_board(&board_b,engines[e].run,slice,&nb);
+		report(p,ref,e,done + 1,slice,&first,&board_a,&board_b);
+		*total = done + na;
+		return 1;
+	}
+	*total = done;
+	return 0;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	char			list[NAMESIZE], *name;
+	unsigned long long	count = CONFORM_COUNT, chunk = CONFORM_CHUNK;
+	unsigned long long	total, sum;
+	unsigned long		seed = CONFORM_SEED;
+	int			use[NENGINES], nuse = 0;
+	int			nrandom = CONFORM_RANDOM;
+	int			c, i, k, fd, failed, diverged = 0;
+
+	while( (c = getopt(argc,argv,"e:r:S:n:k:")) != -1 ) {
+		switch( c ) {
+		   case 'e':
+			snprintf(list,NAMESIZE,"%s",optarg);
+			nuse = 0;
+			for( name = strtok(list,",") ; name != NULL ;
+						name = strtok(NULL,",") ) {
+				for( i = 0 ; i < NENGINES ; i++ )
+					if( !strcmp(name,engines[i].name) )
+						break;
+				if( i == NENGINES || nuse == NENGINES ) {
+					fprintf(stderr,"Unknown engine: %s\n",
+									name);
+					return 2;
+				}
+				use[nuse++] = i;
+			}
+			if( nuse < 2 ) {
+				usage(argv[0]);
+				return 2;
+			}
+			break;
+		   case 'r':
+			if( (nrandom = atoi(optarg)) < 0 ) {
+				usage(argv[0]);
+				return 2;
+			}
+			break;
+		   case 'S':
+			seed = strtoul(optarg,NULL,0);
+			break;
+		   case 'n':
+			if( (count = strtoull(optarg,NULL,0)) == 0 ) {
+				usage(argv[0]);
+				return 2;
+			}
+			break;
+		   case 'k':
+			if( (chunk = strtoull(optarg,NULL,0)) == 0 ) {
+				usage(argv[0]);
+				return 2;
+			}
+			break;
+		   default:
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if( nuse == 0 )
+		for( nuse = 0 ; nuse < 5 ; nuse++ )	/* step..lanes */
+			use[nuse] = nuse;
+
+	init_decode_table();
+	for( i = optind ; i < argc ; i++ )
+		if( add_file(argv[i]) != 0 ) {
+			fprintf(stderr,"Unable to load %s\n",argv[i]);
+			return 2;
+		}
+	if( optind == argc )
+		for( i = 0 ; i < (int)(sizeof(default_files)/sizeof(char *)) ;
+									i++ )
+			if( access(default_files[i],R_OK) == 0 )
+				add_file(default_files[i]);
+	for( k = 0 ; k < nrandom ; k++ )
+		if( add_random(k,seed) != 0 )
+			return 2;
+
+	/*
+	 *   The report goes to the standard output; messages of the engines
+	 *   (HLT, unknown instructions) are thrown away
+	 */
+	fflush(stdout);
+	fflush(stderr);
+	if( (fd = dup(STDOUT_FILENO)) < 0 || (out = fdopen(fd,"w")) == NULL
+	 || (fd = open("/dev/null",O_WRONLY)) < 0
+	 || dup2(fd,STDOUT_FILENO) < 0 || dup2(fd,STDERR_FILENO) < 0 ) {
+		perror("cpu_sim_conform");
+		return 2;
+	}
+	close(fd);
+
+	run_threaded(NULL,0,NULL);
+	run_block(NULL,0,NULL);
+	if( (lanes = lanes_new(1)) == NULL ) {
+		fprintf(out,"Unable to allocate the lanes\n");
+		return 2;
+	}
+
+	for( i = 1 ; i < nuse ; i++ ) {
+		failed = 0;
+		sum = 0;
+		for( k = 0 ; k < nprograms ; k++ ) {
+			failed += lockstep(&programs[k],use[0],use[i],count,
+							chunk,&total);
+			sum += total;
+		}
+		fprintf(out,"%-12s %-12s %6d programs %12llu instructions "
+			"%6d divergent\n",engines[use[0]].name,
+			engines[use[i]].name,nprograms,sum,failed);
+		fflush(out);
+		diverged += failed;
+	}
+	lanes_free(lanes);
+	free(programs);
+	return diverged ? 1 : 0;
+}
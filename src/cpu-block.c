@@ -0,0 +1,386 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	cpu-block.c
+ *	Descrioption:	basic-block translation cache execution engine
+ */
+
+#include	<stddef.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	"cpuboard.h"
+#include	"trace.h"
+#include	"debug.h"
+#include	"engine.h"
+#include	"block.h"
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic ignored "-Wpedantic"	/* &&label, goto *ptr */
+
+
+/* the handler table of run_block(): one per instruction word, then these */
+#define	OP_SLOW		256			/* left to step() */
+#define	OP_END		257			/* block cut at BLOCK_MAX */
+#define	OP_TABLE	258
+
+static void *const	*handlers = NULL;	/* bound by run_block() */
+
+
+/*
+ *   Get the handler table of run_block(), binding it on first use
+ */
+static void *const *
+block_handlers(void)
+{
+	if( handlers == NULL )
+		run_block(NULL,0,NULL);
+	return handlers;
+}
+
+
+/*
+ *   Drop every translation
+ */
+void
+block_flush(Cpub *cpub, struct blockcache *bc)
+{
+	memset(bc->block,0,sizeof(bc->block));
+	bc->used = 0;
+	memset(bc->native,0,sizeof(bc->native));
+	bc->code_used = 0;
+	memset(cpub->codemap,0,sizeof(cpub->codemap));
+	memset(cpub->codedirty,0,sizeof(cpub->codedirty));
+	cpub->codestale = 0;
+}
+
+
+/*
+ *   Get the translation cache of a board (allocated on first use)
+ */
+struct blockcache *
+block_cache(Cpub *cpub)
+{
+	struct blockcache	*bc;
+
+	if( cpub->blocks == NULL ) {
+		if( (bc = calloc(1,sizeof(struct blockcache))) == NULL )
+			return NULL;
+		cpub->blocks = bc;
+		block_flush(cpub,bc);
+	}
+	return cpub->blocks;
+}
+
+
+/*
+ *   Drop the translations covering words reported by CodeWrite()
+ */
+void
+block_sweep(Cpub *cpub, struct blockcache *bc)
+{
+	Block	*blk;
+	int	i, k;
+
+	for( i = 0 ; i < IMEMORY_SIZE ; i++ ) {
+		blk = &bc->block[i];
+		for( k = 0 ; blk->uop != NULL && k < blk->len ; k++ )
+			if( BrkTest(cpub->codedirty,(Uword)(i + k)) ) {
+				blk->uop = NULL;
+				blk->heat = 0;
+				bc->native[i] = NULL;
+			}
+	}
+
+	memset(cpub->codemap,0,sizeof(cpub->codemap));
+	memset(cpub->codedirty,0,sizeof(cpub->codedirty));
+	cpub->codestale = 0;
+	for( i = 0 ; i < IMEMORY_SIZE ; i++ ) {
+		blk = &bc->block[i];
+		for( k = 0 ; blk->uop != NULL && k < blk->len ; k++ )
+			BrkSet(cpub->codemap,(Uword)(i + k));
+	}
+}
+
+
+/*
+ *   Get the block entered at pc, translating it if necessary
+ */
+Block *
+block_get(Cpub *cpub, struct blockcache *bc, Uword pc)
+{
+	void *const		*optab;
+	const InstructionInfo	*e;
+	Block			*blk = &bc->block[pc];
+	Uop			*u;
+	Uword			a = pc;
+	int			last, cut;
+
+	if( blk->uop != NULL )
+		return blk;
+	optab = block_handlers();
+
+	if( bc->used + BLOCK_MAX + 1 > UOP_POOL )
+		block_flush(cpub,bc);
+	blk->uop = u = &bc->pool[bc->used];
+	blk->n = 0;
+	blk->heat = 0;
+
+	do {
+		e = &decode_table[cpub->mem[a]];
+		u->op = optab[cpub->mem[a]];
+		u->slow = (u->op == optab[OP_SLOW]);
+		u->inst = cpub->mem[a];
+		u->pc = a;
+		u->imm = cpub->mem[(Uword)(a + 1)];
+		u->ea = u->imm;
+		if( e->addr_mode_b == ADDR_MODE_ABS_DATA )
+			u->ea |= 0x100;
+		last = (u->slow || e->type == INST_Bbc
+				|| e->type == INST_JAL || e->type == INST_JR);
+		/* native code leaves IN and OUT to step(): cut after them */
+		cut = (e->type == INST_IN || e->type == INST_OUT);
+
+		BrkSet(cpub->codemap,a);
+		if( !u->slow && e->word_length == 2 )
+			BrkSet(cpub->codemap,(Uword)(a + 1));
+		u->next = a + (u->slow ? 1 : e->word_length);
+
+		a = u->next;
+		u++;
+		blk->n++;
+	} while( !last && !cut && blk->n < BLOCK_MAX );
+
+	if( !last ) {
+		u->op = optab[OP_END];
+		u->slow = 0;
+		u->pc = a;
+		u++;
+	}
+	blk->len = (Uword)(a - pc);
+	bc->used = u - bc->pool;
+	return blk;
+}
+
+
+/*=============================================================================
+ *   Operand B Access from a Micro-op (same effective addresses as step())
+ *===========================================================================*/
+#define	UOPB_ACC	ea = 0, b = acc
+#define	UOPB_IX		ea = 0, b = ix
+#define	UOPB_IMM	ea = 0, b = u->imm
+#define	UOPB_ABSP	ea = u->ea, b = mem[ea]
+#define	UOPB_ABSD	ea = u->ea, b = mem[ea]
+#define	UOPB_IXP	ea = (Uword)(ix + u->imm), b = mem[ea]
+#define	UOPB_IXD	ea = 0x100 | (Uword)(ix + u->imm), b = mem[ea]
+
+#define	UNEXT		u++; goto *u->op
+
+#define	HANDLER(OP,X,R,M)	OP##_##X##_##M: UOPB_##M; OP_##OP(R); UNEXT;
+
+/* a store into a translated word ends the block right after the ST */
+#undef	OP_ST
+#define	OP_ST(R)	mem[ea] = R;					\
+			if( ea < IMEMORY_SIZE && BrkTest(cpub->codemap,ea) ) \
+				goto code_written
+
+
+/*=============================================================================
+ *   Run a Program until HLT, an Error, or the Limit, Block by Block
+ *
+ *   The budget is charged once per block; a block longer than what is left
+ *   is finished by run_threaded().  Runs that need a per-instruction check
+ *   (trace, break-points, watch-points) are handed to run_threaded() as a
+ *   whole.  Translations are dropped when CodeWrite() reports a write into
+ *   them, and a block that stores into translated code stops after the ST.
+ *===========================================================================*/
+int
+run_block(Cpub *cpub, unsigned long long limit, unsigned long long *count)
+{
+	/* indexed by [type - INST_LD][A field][addressing mode] */
+	static void *const	op_labels[ENGINE_OPS][2][7] = {
+		LABELS(LD), LABELS(ST), LABELS(ADD), LABELS(ADC),
+		LABELS(SUB), LABELS(SBC), LABELS(CMP), LABELS(AND),
+		LABELS(OR), LABELS(EOR)
+	};
+	/* indexed by BranchCondition */
+	static void *const	br_labels[BRANCH_COND_NONE + 1] = {
+		&&B_A, &&B_VF, &&B_NZ, &&B_Z, &&B_ZP, &&B_N, &&B_P,
+		&&B_ZN, &&B_NI, &&B_NO, &&B_NC, &&B_C, &&B_GE,
+		&&B_LT, &&B_GT, &&B_LE, &&B_NEVER
+	};
+	static void		*optab[OP_TABLE];
+
+	struct blockcache	*bc;
+	Block			*blk;
+	const Uop		*u;
+	Uword			*mem;
+	Uword			pc, acc, ix, a, b, r;
+	Bit			cf, vf, nf, zf;
+	Addr			ea;
+	unsigned long long	left, done;
+	int			i, result;
+
+	/*
+	 *   Bind every instruction word to its handler (first call only)
+	 */
+	if( handlers == NULL ) {
+		for( i = 0 ; i < 256 ; i++ ) {
+			const InstructionInfo	*e = &decode_table[i];
+
+			switch( e->type ) {
+			   case INST_NOP:	optab[i] = &&NOP; break;
+			   case INST_RCF:	optab[i] = &&RCF; break;
+			   case INST_SCF:	optab[i] = &&SCF; break;
+			   case INST_IN:	optab[i] = &&IN; break;
+			   case INST_OUT:	optab[i] = &&OUT; break;
+			   case INST_JR:	optab[i] = &&JR; break;
+			   case INST_JAL:
+				optab[i] = e->a_field ? &&JAL_X : &&JAL_A;
+				break;
+			   case INST_Bbc:
+				optab[i] = br_labels[e->branch_cond];
+				break;
+			   case INST_LD: case INST_ST:
+			   case INST_ADD: case INST_ADC: case INST_SUB:
+			   case INST_SBC: case INST_CMP: case INST_AND:
+			   case INST_OR: case INST_EOR:
+				if( e->addr_mode_b == ADDR_MODE_NONE )
+					optab[i] = &&SLOW;
+				else
+					optab[i] = op_labels[e->type - INST_LD]
+						[e->a_field][e->addr_mode_b];
+				break;
+			   default:		optab[i] = &&SLOW; break;
+			}
+		}
+		optab[OP_SLOW] = &&SLOW;
+		optab[OP_END] = &&END;
+		handlers = optab;
+	}
+
+	if( count != NULL )
+		*count = 0;
+	if( cpub == NULL || limit == 0 )
+		return RUN_STEP;
+	for( i = 0 ; i < IMEMORY_SIZE/8 && cpub->brkmap[i] == 0 ; i++ )
+		;
+	if( i < IMEMORY_SIZE/8 || TRACE_ENABLED() || cpub->trace != NULL
+	 || cpub->undo != NULL || cpub->prof != NULL || cpub->timing != NULL
+	 || (cpub->debug != NULL && cpub->debug->nwatch > 0) )
+		return run_threaded(cpub,limit,count);
+	if( (bc = block_cache(cpub)) == NULL )
+		return run_threaded(cpub,limit,count);
+
+	mem = cpub->mem;
+	pc = cpub->pc; acc = cpub->acc; ix = cpub->ix;
+	cf = cpub->cf; vf = cpub->vf; nf = cpub->nf; zf = cpub->zf;
+	left = limit;
+	result = RUN_STEP;
+	a = b = r = 0;
+	ea = 0;
+
+	if( cpub->codestale )		/* 'w', 'r' or another engine */
+		block_sweep(cpub,bc);
+
+     next_block:
+	if( left == 0 )
+		goto stop;
+	blk = block_get(cpub,bc,pc);
+	if( (unsigned long long)blk->n > left ) {
+		cpub->pc = pc; cpub->acc = acc; cpub->ix = ix;
+		cpub->cf = cf; cpub->vf = vf; cpub->nf = nf; cpub->zf = zf;
+		result = run_threaded(cpub,left,&done);
+		left -= done;
+		goto done;
+	}
+	left -= blk->n;
+	u = blk->uop;
+	goto *u->op;
+
+	HANDLERS(LD)  HANDLERS(ST)  HANDLERS(ADD) HANDLERS(ADC)
+	HANDLERS(SUB) HANDLERS(SBC) HANDLERS(CMP) HANDLERS(AND)
+	HANDLERS(OR)  HANDLERS(EOR)
+
+     NOP:	UNEXT;
+     RCF:	cf = 0; UNEXT;
+     SCF:	cf = 1; UNEXT;
+     IN:	acc = iobuf_take(cpub->ibuf); UNEXT;
+     OUT:	iobuf_put(&cpub->obuf,acc); UNEXT;
+     END:	pc = u->pc; goto next_block;
+     JR:	pc = acc; goto next_block;
+     JAL_A:	acc = u->next; pc = u->ea; goto next_block;	/* PC+2 */
+     JAL_X:	ix = u->next; pc = u->ea; goto next_block;
+
+     B_A:	pc = u->ea; goto next_block;
+     B_VF:	pc = vf ? u->ea : u->next; goto next_block;
+     B_NZ:	pc = !zf ? u->ea : u->next; goto next_block;
+     B_Z:	pc = zf ? u->ea : u->next; goto next_block;
+     B_ZP:	pc = !nf ? u->ea : u->next; goto next_block;
+     B_N:	pc = nf ? u->ea : u->next; goto next_block;
+     B_P:	pc = (!nf && !zf) ? u->ea : u->next; goto next_block;
+     B_ZN:	pc = (nf || zf) ? u->ea : u->next; goto next_block;
+     B_NI:	pc = !iobuf_ready(cpub->ibuf) ? u->ea : u->next;
+		goto next_block;
+     B_NO:	pc = iobuf_ready(&cpub->obuf) ? u->ea : u->next;
+		goto next_block;
+     B_NC:	pc = !cf ? u->ea : u->next; goto next_block;
+     B_C:	pc = cf ? u->ea : u->next; goto next_block;
+     B_GE:	pc = !(vf ^ nf) ? u->ea : u->next; goto next_block;
+     B_LT:	pc = (vf ^ nf) ? u->ea : u->next; goto next_block;
+     B_GT:	pc = (!(vf ^ nf) && !zf) ? u->ea : u->next; goto next_block;
+     B_LE:	pc = ((vf ^ nf) || zf) ? u->ea : u->next; goto next_block;
+     B_NEVER:	pc = u->next; goto next_block;
+
+     SLOW:
+	cpub->pc = u->pc; cpub->acc = acc; cpub->ix = ix;
+	cpub->cf = cf; cpub->vf = vf; cpub->nf = nf; cpub->zf = zf;
+	if( step(cpub) == RUN_HALT ) {
+		result = RUN_HALT;
+		goto done;
+	}
+	pc = cpub->pc; acc = cpub->acc; ix = cpub->ix;
+	cf = cpub->cf; vf = cpub->vf; nf = cpub->nf; zf = cpub->zf;
+	if( cpub->codestale )		/* ST executed by step() */
+		block_sweep(cpub,bc);
+	goto next_block;
+
+     code_written:
+	left += blk->n - (u - blk->uop + 1);	/* not run after the ST */
+	pc = u->next;
+	CodeWrite(cpub,ea);
+	block_sweep(cpub,bc);
+	goto next_block;
+
+     stop:
+	cpub->pc = pc; cpub->acc = acc; cpub->ix = ix;
+	cpub->cf = cf; cpub->vf = vf; cpub->nf = nf; cpub->zf = zf;
+     done:
+	if( count != NULL )
+		*count = limit - left;
+	return result;
+}
+
+#else	/* !__GNUC__: no computed goto, fall back to step() */
+
+int
+run_block(Cpub *cpub, unsigned long long limit, unsigned long long *count)
+{
+	return run_step(cpub,limit,count);
+}
+
+#endif
+
+
+/*
+ *   Release the translation cache of a board
+ */
+void
+block_free(Cpub *cpub)
+{
+	if( cpub->blocks == NULL )
+		return;
+	jit_free(cpub->blocks);
+	free(cpub->blocks);
+	cpub->blocks = NULL;
+}
@@ -0,0 +1,737 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	cpu-jit.c
+ *	Descrioption:	x86-64 native code generator for hot blocks, and a
+ *			differential check of an engine against step()
+ */
+
+#define	_DEFAULT_SOURCE		/* MAP_ANONYMOUS */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	"cpuboard.h"
+#include	"trace.h"
+#include	"debug.h"
+#include	"block.h"
+#include	"iodev.h"
+
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__)
+#include	<sys/mman.h>
+
+
+/*=============================================================================
+ *   Native Code Layout
+ *
+ *   Generated code keeps the board in host registers while it runs and
+ *   chains directly from block to block through the native[] table:
+ *
+ *	rbx	mem[] base		r14d	ACC	r8d	CF
+ *	rbp	JitState		r15d	IX	r9d	VF
+ *	r12	native[] table				r10d	NF
+ *	r13	instructions left			r11d	ZF
+ *
+ *   Every block first charges its length to r13 (and leaves if the budget
+ *   is short), so the budget is exact at block boundaries.  Native code
+ *   returns to C with the next PC and the reason in JitState/eax: no
+ *   native code for the next block, an instruction left to step() (IN,
+ *   OUT, HLT, ...), or an ST into translated code.
+ *===========================================================================*/
+#define	JIT_HOT		8			/* entries before translation */
+#define	JIT_CODE_SIZE	(1 << 20)		/* native code per board */
+#define	JIT_BLOCK_CODE	(BLOCK_MAX * 96 + 64)	/* worst case of a block */
+
+#define	JIT_EXIT_BLOCK	0	/* next block has no native code/budget */
+#define	JIT_EXIT_SLOW	1	/* the instruction at pc is left to step() */
+#define	JIT_EXIT_STORE	2	/* ST into translated code at ea */
+
+/* IN, OUT, BNI and BNO go through step(); they end their blocks */
+#define	JIT_BY_STEP(inf)	((inf)->type == INST_IN || (inf)->type == INST_OUT \
+			|| ((inf)->type == INST_Bbc				\
+			 && ((inf)->branch_cond == BRANCH_COND_NI		\
+			  || (inf)->branch_cond == BRANCH_COND_NO)))
+
+typedef struct jitstate {
+	Uword			*mem;
+	void			**native;
+	Uword			*codemap;
+	unsigned long long	left;
+	unsigned int		acc, ix, cf, vf, nf, zf;
+	unsigned int		pc, ea;
+} JitState;
+
+#define	SO(f)	(unsigned int)offsetof(JitState,f)
+
+/* host registers */
+#define	RAX	0
+#define	RCX	1
+#define	RDX	2
+#define	RBX	3
+#define	RBP	5
+#define	RSI	6
+#define	RDI	7
+#define	R_CF	8
+#define	R_VF	9
+#define	R_NF	10
+#define	R_ZF	11
+#define	R12	12
+#define	R13	13
+#define	R_ACC	14
+#define	R_IX	15
+
+/* condition codes */
+#define	CC_O	0x0
+#define	CC_C	0x2
+#define	CC_NC	0x3
+#define	CC_Z	0x4
+#define	CC_NZ	0x5
+#define	CC_S	0x8
+
+
+/*=============================================================================
+ *   Instruction Encoder
+ *===========================================================================*/
+typedef struct emit {
+	unsigned char	*base;	/* code buffer */
+	unsigned char	*p;	/* next byte */
+	size_t		exit_off;	/* offset of the common exit */
+} Emit;
+
+static void
+e1(Emit *e, unsigned int b)
+{
+	*e->p++ = (unsigned char)b;
+}
+
+static void
+e4(Emit *e, unsigned int v)
+{
+	e1(e,v); e1(e,v >> 8); e1(e,v >> 16); e1(e,v >> 24);
+}
+
+/* REX prefix; byte: 8-bit register operands (spl..dil need a REX) */
+static void
+rex(Emit *e, int w, int reg, int rm, int byte)
+{
+	unsigned int	r = 0x40 | (w << 3) | ((reg >> 3) << 2) | (rm >> 3);
+
+	if( r != 0x40 || (byte && (reg >= 4 || rm >= 4)) )
+		e1(e,r);
+}
+
+static void
+opcode(Emit *e, unsigned int opc)
+{
+	if( opc > 0xff )
+		e1(e,opc >> 8);
+	e1(e,opc);
+}
+
+/* opc reg, rm (register operands) */
+static void
+op_rr(Emit *e, int w, int byte, unsigned int opc, int reg, int rm)
+{
+	rex(e,w,reg,rm,byte);
+	opcode(e,opc);
+	e1(e,0xc0 | (reg & 7) << 3 | (rm & 7));
+}
+
+/* opc reg, [rbp+disp8] */
+static void
+op_state(Emit *e, int w, unsigned int opc, int reg, unsigned int disp)
+{
+	rex(e,w,reg,RBP,0);
+	opcode(e,opc);
+	e1(e,0x45 | (reg & 7) << 3);
+	e1(e,disp);
+}
+
+/* opc reg8, [rbx+disp32] */
+static void
+op_mem(Emit *e, unsigned int opc, int reg, unsigned int disp)
+{
+	rex(e,0,reg,RBX,1);
+	opcode(e,opc);
+	e1(e,0x83 | (reg & 7) << 3);
+	e4(e,disp);
+}
+
+/* opc reg8, [rbx+rsi] */
+static void
+op_mem_rsi(Emit *e, unsigned int opc, int reg)
+{
+	rex(e,0,reg,RBX,1);
+	opcode(e,opc);
+	e1(e,0x04 | (reg & 7) << 3);
+	e1(e,0x33);
+}
+
+static void
+mov_ri(Emit *e, int reg, unsigned int imm)
+{
+	rex(e,0,0,reg,0);
+	e1(e,0xb8 + (reg & 7));
+	e4(e,imm);
+}
+
+static void
+mov_rr(Emit *e, int dst, int src)
+{
+	op_rr(e,0,0,0x89,src,dst);
+}
+
+static void
+setcc(Emit *e, int cc, int reg)
+{
+	op_rr(e,0,1,0x0f90 | cc,0,reg);
+}
+
+static void
+jmp_exit(Emit *e, unsigned int reason)
+{
+	mov_ri(e,RAX,reason);
+	e1(e,0xe9);
+	e4(e,(unsigned int)(e->base + e->exit_off - (e->p + 4)));
+}
+
+
+/*=============================================================================
+ *   Entry and Exit (at the start of every code buffer)
+ *
+ *   int enter(JitState *s, void *code): load the state, run native code
+ *   from code and return the exit reason with the state stored back.
+ *===========================================================================*/
+static const struct {
+	int		reg;
+	unsigned int	off;
+} state_regs[] = {
+	{ R_ACC, SO(acc) }, { R_IX, SO(ix) }, { R_CF, SO(cf) },
+	{ R_VF, SO(vf) }, { R_NF, SO(nf) }, { R_ZF, SO(zf) }
+};
+#define	NSTATE_REGS	(int)(sizeof(state_regs)/sizeof(state_regs[0]))
+
+static void
+jit_emit_entry(Emit *e)
+{
+	int	i;
+
+	/* enter: */
+	e1(e,0x53); e1(e,0x55);				/* push rbx,rbp */
+	e1(e,0x41); e1(e,0x54); e1(e,0x41); e1(e,0x55);	/* push r12,r13 */
+	e1(e,0x41); e1(e,0x56); e1(e,0x41); e1(e,0x57);	/* push r14,r15 */
+	op_rr(e,1,0,0x89,RDI,RBP);			/* mov rbp,rdi */
+	op_state(e,1,0x8b,RBX,SO(mem));
+	op_state(e,1,0x8b,R12,SO(native));
+	op_state(e,1,0x8b,R13,SO(left));
+	for( i = 0 ; i < NSTATE_REGS ; i++ )
+		op_state(e,0,0x8b,state_regs[i].reg,state_regs[i].off);
+	e1(e,0xff); e1(e,0xe6);				/* jmp rsi */
+
+	/* exit: (esi = pc, eax = reason) */
+	e->exit_off = e->p - e->base;
+	op_state(e,0,0x89,RSI,SO(pc));
+	op_state(e,1,0x89,R13,SO(left));
+	for( i = 0 ; i < NSTATE_REGS ; i++ )
+		op_state(e,0,0x89,state_regs[i].reg,state_regs[i].off);
+	e1(e,0x41); e1(e,0x5f); e1(e,0x41); e1(e,0x5e);	/* pop r15,r14 */
+	e1(e,0x41); e1(e,0x5d); e1(e,0x41); e1(e,0x5c);	/* pop r13,r12 */
+	e1(e,0x5d); e1(e,0x5b);				/* pop rbp,rbx */
+	e1(e,0xc3);					/* ret */
+}
+
+
+/*=============================================================================
+ *   Block Translation
+ *===========================================================================*/
+
+/*
+ *   Operand B into ecx (unless store) and, for memory modes, its
+ *   effective address into esi if it is not known (returns -1 then)
+ */
+static int
+jit_operand_b(Emit *e, const InstructionInfo *inf, const Uop *u, int store)
+{
+	switch( inf->addr_mode_b ) {
+	   case ADDR_MODE_REG_ACC:
+		if( !store ) mov_rr(e,RCX,R_ACC);
+		return 0;
+	   case ADDR_MODE_REG_IX:
+		if( !store ) mov_rr(e,RCX,R_IX);
+		return 0;
+	   case ADDR_MODE_IMMEDIATE:
+		if( !store ) mov_ri(e,RCX,u->imm);
+		return 0;
+	   case ADDR_MODE_ABS_PROG:
+	   case ADDR_MODE_ABS_DATA:
+		if( !store ) op_mem(e,0x0fb6,RCX,u->ea);  /* movzx ecx,[] */
+		return u->ea;
+	   default:					/* (IX+d) */
+		rex(e,0,RSI,R_IX,0);			/* lea esi,[r15+d] */
+		e1(e,0x8d);
+		e1(e,0x80 | (RSI << 3) | (R_IX & 7));
+		e4(e,u->imm);
+		op_rr(e,0,1,0x0fb6,RSI,RSI);		/* movzx esi,sil */
+		if( inf->addr_mode_b == ADDR_MODE_IX_DATA ) {
+			op_rr(e,0,0,0x81,1,RSI);	/* or esi,0x100 */
+			e4(e,0x100);
+		}
+		if( !store ) op_mem_rsi(e,0x0fb6,RCX);
+		return -1;
+	}
+}
+
+/* ST: mem[ea] = R, leaving the block if a translated word was written */
+static void
+jit_store(Emit *e, const InstructionInfo *inf, const Uop *u, int reg,
+								int left_over)
+{
+	unsigned char	*skip = NULL, *jnc;
+	int		ea;
+
+	ea = jit_operand_b(e,inf,u,1);
+	if( ea >= 0 )
+		op_mem(e,0x88,reg,ea);
+	else
+		op_mem_rsi(e,0x88,reg);
+	if( ea >= IMEMORY_SIZE )
+		return;
+
+	if( ea >= 0 ) {
+		mov_ri(e,RSI,ea);
+	} else {
+		op_rr(e,0,0,0x81,7,RSI); e4(e,IMEMORY_SIZE);	/* cmp esi,.. */
+		e1(e,0x73); skip = e->p; e1(e,0);		/* jae skip */
+	}
+	op_state(e,1,0x8b,RAX,SO(codemap));
+	e1(e,0x0f); e1(e,0xa3); e1(e,0x30);		/* bt [rax],esi */
+	e1(e,0x73); jnc = e->p; e1(e,0);		/* jnc skip */
+
+	op_state(e,0,0x89,RSI,SO(ea));
+	op_rr(e,1,0,0x81,0,R13); e4(e,left_over);	/* add r13,left_over */
+	mov_ri(e,RSI,u->next);
+	jmp_exit(e,JIT_EXIT_STORE);
+
+	*jnc = (unsigned char)(e->p - jnc - 1);
+	if( skip != NULL )
+		*skip = (unsigned char)(e->p - skip - 1);
+}
+
+/* ALU operation on R with operand B in ecx; flags as execute_alu_operation() */
+static void
+jit_alu(Emit *e, InstructionType type, int reg)
+{
+	static const unsigned int	opc8[] = {
+		/* INST_ADD .. INST_EOR */
+		0x00, 0x10, 0x28, 0x18, 0x28, 0x20, 0x08, 0x30
+	};
+	unsigned int	opc = opc8[type - INST_ADD];
+
+	switch( type ) {
+	   case INST_ADD:
+		op_rr(e,0,1,opc,RCX,reg);
+		setcc(e,CC_C,R_CF); setcc(e,CC_O,R_VF);
+		setcc(e,CC_S,R_NF); setcc(e,CC_Z,R_ZF);
+		return;
+	   case INST_ADC:		/* CF comes from a + b without carry-in */
+		mov_rr(e,RDX,reg);
+		op_rr(e,0,1,0x00,RCX,RDX);		/* add dl,cl */
+		setcc(e,CC_C,RAX);
+		op_rr(e,0,0,0x0fba,4,R_CF); e1(e,0);	/* bt r8d,0 */
+		op_rr(e,0,1,opc,RCX,reg);
+		setcc(e,CC_O,R_VF); setcc(e,CC_S,R_NF); setcc(e,CC_Z,R_ZF);
+		op_rr(e,0,1,0x0fb6,R_CF,RAX);		/* movzx r8d,al */
+		return;
+	   case INST_SUB:
+	   case INST_SBC:
+	   case INST_CMP:		/* r in eax, VF from a + (-b) */
+		mov_rr(e,RDX,reg);
+		mov_rr(e,RAX,reg);
+		if( type == INST_SBC ) {
+			op_rr(e,0,0,0x0fba,4,R_CF); e1(e,0);
+			op_rr(e,0,1,0x18,RCX,RAX);	/* sbb al,cl */
+		} else {
+			op_rr(e,0,1,0x28,RCX,RAX);	/* sub al,cl */
+		}
+		setcc(e,CC_S,R_NF); setcc(e,CC_Z,R_ZF);
+		op_rr(e,0,1,0x38,RCX,RDX);		/* cmp dl,cl */
+		setcc(e,CC_NC,R_CF);
+		mov_rr(e,RDI,RCX);
+		op_rr(e,0,0,0xf7,3,RDI);		/* neg edi */
+		op_rr(e,0,0,0x31,RDX,RDI);		/* xor edi,edx */
+		op_rr(e,0,0,0xf7,2,RDI);		/* not edi */
+		mov_rr(e,RSI,RDX);
+		op_rr(e,0,0,0x31,RAX,RSI);		/* xor esi,eax */
+		op_rr(e,0,0,0x21,RSI,RDI);		/* and edi,esi */
+		op_rr(e,0,0,0xc1,5,RDI); e1(e,7);	/* shr edi,7 */
+		op_rr(e,0,0,0x83,4,RDI); e1(e,1);	/* and edi,1 */
+		mov_rr(e,R_VF,RDI);
+		if( type != INST_CMP )
+			op_rr(e,0,1,0x0fb6,reg,RAX);	/* movzx R,al */
+		return;
+	   default:			/* AND, OR, EOR */
+		op_rr(e,0,1,opc,RCX,reg);
+		setcc(e,CC_S,R_NF); setcc(e,CC_Z,R_ZF);
+		op_rr(e,0,0,0x31,R_CF,R_CF);		/* xor r8d,r8d */
+		op_rr(e,0,0,0x31,R_VF,R_VF);
+		return;
+	}
+}
+
+/* esi = (condition of the branch) ? ea : next */
+static void
+jit_branch(Emit *e, BranchCondition bc, const Uop *u)
+{
+	int	flag = -1, flag2 = -1, x = 0, cc = CC_NZ;
+
+	switch( bc ) {
+	   case BRANCH_COND_A:	mov_ri(e,RSI,u->ea); return;
+	   case BRANCH_COND_VF:	flag = R_VF; break;
+	   case BRANCH_COND_NZ:	flag = R_ZF; cc = CC_Z; break;
+	   case BRANCH_COND_Z:	flag = R_ZF; break;
+	   case BRANCH_COND_ZP:	flag = R_NF; cc = CC_Z; break;
+	   case BRANCH_COND_N:	flag = R_NF; break;
+	   case BRANCH_COND_P:	flag = R_NF; flag2 = R_ZF; cc = CC_Z; break;
+	   case BRANCH_COND_ZN:	flag = R_NF; flag2 = R_ZF; break;
+	   case BRANCH_COND_NC:	flag = R_CF; cc = CC_Z; break;
+	   case BRANCH_COND_C:	flag = R_CF; break;
+	   case BRANCH_COND_GE:	flag = R_VF; x = 1; cc = CC_Z; break;
+	   case BRANCH_COND_LT:	flag = R_VF; x = 1; break;
+	   case BRANCH_COND_GT:	flag = R_VF; x = 1; flag2 = R_ZF; cc = CC_Z;
+				break;
+	   case BRANCH_COND_LE:	flag = R_VF; x = 1; flag2 = R_ZF; break;
+	   default:		mov_ri(e,RSI,u->next); return;	/* never */
+	}
+	mov_ri(e,RSI,u->next);
+	mov_ri(e,RAX,u->ea);
+	mov_rr(e,RDI,flag);
+	if( x )
+		op_rr(e,0,0,0x31,R_NF,RDI);		/* xor edi,r10d */
+	if( flag2 >= 0 )
+		op_rr(e,0,0,0x09,flag2,RDI);		/* or edi,flag2 */
+	op_rr(e,0,0,0x85,RDI,RDI);			/* test edi,edi */
+	op_rr(e,0,0,0x0f40 | cc,RSI,RAX);		/* cmovcc esi,eax */
+}
+
+/*
+ *   Translate a block into native code at bc->code + bc->code_used
+ *   Returns -1 if the buffer is full.
+ */
+static int
+jit_translate(struct blockcache *bc, Uword pc, const Block *blk)
+{
+	const InstructionInfo	*inf;
+	const Uop		*u;
+	Emit			e;
+	unsigned char		*body;
+	int			i, reg;
+
+	if( bc->code_used + JIT_BLOCK_CODE > JIT_CODE_SIZE )
+		return -1;
+	e.base = bc->code;
+	e.p = bc->code + bc->code_used;
+	e.exit_off = bc->code_exit;
+	bc->native[pc] = e.p;
+
+	/* charge the block, or leave if the budget is short */
+	op_rr(&e,1,0,0x81,7,R13); e4(&e,blk->n);	/* cmp r13,n */
+	e1(&e,0x73); body = e.p; e1(&e,0);		/* jae body */
+	mov_ri(&e,RSI,pc);
+	jmp_exit(&e,JIT_EXIT_BLOCK);
+	*body = (unsigned char)(e.p - body - 1);
+	op_rr(&e,1,0,0x81,5,R13); e4(&e,blk->n);	/* sub r13,n */
+
+	for( i = 0, u = blk->uop ; ; i++, u++ ) {
+		if( i == blk->n ) {			/* cut at BLOCK_MAX */
+			mov_ri(&e,RSI,u->pc);
+			break;
+		}
+		inf = &decode_table[u->inst];
+		if( u->slow || JIT_BY_STEP(inf) ) {
+			mov_ri(&e,RSI,u->pc);
+			jmp_exit(&e,JIT_EXIT_SLOW);
+			goto done;
+		}
+		reg = inf->a_field ? R_IX : R_ACC;
+		switch( inf->type ) {
+		   case INST_NOP:	continue;
+		   case INST_RCF:	mov_ri(&e,R_CF,0); continue;
+		   case INST_SCF:	mov_ri(&e,R_CF,1); continue;
+		   case INST_LD:
+			jit_operand_b(&e,inf,u,0);
+			mov_rr(&e,reg,RCX);
+			continue;
+		   case INST_ST:
+			jit_store(&e,inf,u,reg,blk->n - i - 1);
+			continue;
+		   case INST_JR:
+			mov_rr(&e,RSI,R_ACC);
+			break;
+		   case INST_JAL:
+			mov_ri(&e,reg,u->next);
+			mov_ri(&e,RSI,u->ea);
+			break;
+		   case INST_Bbc:
+			jit_branch(&e,inf->branch_cond,u);
+			break;
+		   default:
+			jit_operand_b(&e,inf,u,0);
+			jit_alu(&e,inf->type,reg);
+			continue;
+		}
+		break;
+	}
+
+	/* chain to the next block: esi = pc */
+	e1(&e,0x49); e1(&e,0x8b); e1(&e,0x04); e1(&e,0xf4);	/* mov rax,[r12+rsi*8] */
+	e1(&e,0x48); e1(&e,0x85); e1(&e,0xc0);		/* test rax,rax */
+	e1(&e,0x74); e1(&e,0x02);			/* jz exit */
+	e1(&e,0xff); e1(&e,0xe0);			/* jmp rax */
+	jmp_exit(&e,JIT_EXIT_BLOCK);
+
+     done:
+	bc->code_used = e.p - bc->code;
+	return 0;
+}
+
+
+/*
+ *   Prepare the native code buffer of a cache (entry/exit code first)
+ */
+static int
+jit_buffer(struct blockcache *bc)
+{
+	Emit	e;
+
+	if( bc->code == NULL ) {
+		bc->code = mmap(NULL,JIT_CODE_SIZE,
+				PROT_READ | PROT_WRITE | PROT_EXEC,
+				MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+		if( bc->code == MAP_FAILED ) {
+			bc->code = NULL;
+			return -1;
+		}
+		bc->code_used = 0;
+	}
+	if( bc->code_used == 0 ) {
+		e.base = e.p = bc->code;
+		jit_emit_entry(&e);
+		bc->code_used = e.p - e.base;
+		bc->code_exit = e.exit_off;
+	}
+	return 0;
+}
+
+
+/*
+ *   Unmap the native code buffer of a cache
+ */
+void
+jit_free(struct blockcache *bc)
+{
+	if( bc->code != NULL )
+		munmap(bc->code,JIT_CODE_SIZE);
+	bc->code = NULL;
+	bc->code_used = 0;
+}
+
+
+/*=============================================================================
+ *   Run a Program until HLT, an Error, or the Limit with Native Code
+ *
+ *   Blocks run as micro-ops (run_block()) until they have been entered
+ *   JIT_HOT times and then as native code.  Instructions without native
+ *   code (IN, OUT, HLT, shift/rotate, ...) are executed by step(), and an
+ *   ST into translated code returns to C so that the translations covering
+ *   it are dropped before running on.  Runs that need per-instruction
+ *   checks are handed to run_threaded() as a whole.
+ *===========================================================================*/
+int
+run_jit(Cpub *cpub, unsigned long long limit, unsigned long long *count)
+{
+	static int		no_exec = 0;	/* mmap(PROT_EXEC) refused;
+						   boards may run on threads */
+	struct blockcache	*bc;
+	Block			*blk;
+	JitState		s;
+	int			(*enter)(JitState *, void *);
+	unsigned long long	left, n;
+	int			i, result, reason;
+
+	if( count != NULL )
+		*count = 0;
+	if( cpub == NULL || limit == 0 )
+		return RUN_STEP;
+	for( i = 0 ; i < IMEMORY_SIZE/8 && cpub->brkmap[i] == 0 ; i++ )
+		;
+	if( i < IMEMORY_SIZE/8 || TRACE_ENABLED() || cpub->trace != NULL
+	 || cpub->undo != NULL || cpub->prof != NULL || cpub->timing != NULL
+	 || (cpub->debug != NULL && cpub->debug->nwatch > 0) )
+		return run_threaded(cpub,limit,count);
+	if( __atomic_load_n(&no_exec,__ATOMIC_RELAXED)
+	 || (bc = block_cache(cpub)) == NULL )
+		return run_block(cpub,limit,count);
+	if( jit_buffer(bc) != 0 ) {
+		__atomic_store_n(&no_exec,1,__ATOMIC_RELAXED);
+		return run_block(cpub,limit,count);
+	}
+
+	s.mem = cpub->mem;
+	s.native = bc->native;
+	s.codemap = cpub->codemap;
+	left = limit;
+	result = RUN_STEP;
+
+	while( left > 0 && result == RUN_STEP ) {
+		if( cpub->codestale )
+			block_sweep(cpub,bc);
+		blk = block_get(cpub,bc,cpub->pc);
+		if( bc->code_used == 0 )		/* flushed by block_get() */
+			jit_buffer(bc);
+		if( bc->native[cpub->pc] == NULL && ++blk->heat >= JIT_HOT
+		 && jit_translate(bc,cpub->pc,blk) != 0 ) {
+			block_flush(cpub,bc);		/* buffer full */
+			continue;
+		}
+
+		n = blk->n;
+		if( bc->native[cpub->pc] == NULL || n > left ) {
+			result = run_block(cpub,n < left ? n : left,&n);
+			left -= n;
+			continue;
+		}
+
+		/*
+		 *   Native code, until a block without it or step() is needed
+		 */
+		s.left = left;
+		s.acc = cpub->acc; s.ix = cpub->ix;
+		s.cf = cpub->cf; s.vf = cpub->vf; s.nf = cpub->nf; s.zf = cpub->zf;
+		memcpy(&enter,&bc->code,sizeof(enter));
+		reason = enter(&s,bc->native[cpub->pc]);
+		left = s.left;
+		cpub->pc = s.pc; cpub->acc = s.acc; cpub->ix = s.ix;
+		cpub->cf = s.cf; cpub->vf = s.vf; cpub->nf = s.nf; cpub->zf = s.zf;
+
+		if( reason == JIT_EXIT_SLOW ) {		/* already charged */
+			if( step(cpub) == RUN_HALT )
+				result = RUN_HALT;
+		} else if( reason == JIT_EXIT_STORE ) {
+			CodeWrite(cpub,s.ea);
+		}
+	}
+
+	if( count != NULL )
+		*count = limit - left;
+	return result;
+}
+
+#else	/* no x86-64 code generator: run the micro-ops */
+
+int
+run_jit(Cpub *cpub, unsigned long long limit, unsigned long long *count)
+{
+	return run_block(cpub,limit,count);
+}
+
+void
+jit_free(struct blockcache *bc)
+{
+	(void)bc;
+}
+
+#endif
+
+
+/*=============================================================================
+ *   Differential Check of the Native Code against step()
+ *
+ *   Runs run_jit() in slices of JIT_CHECK_SLICE instructions on the board
+ *   and the same number of step()s on a shadow copy, and stops with
+ *   RUN_BREAK at the first slice after which registers, flags or memory
+ *   differ.  Both states are printed then.  A shadow of an I/O device
+ *   reads the same input bytes from its buffer (filled with a slice of
+ *   them first) and writes to a scratch buffer.
+ *===========================================================================*/
+#define	JIT_CHECK_SLICE	64
+
+static void
+print_state(const char *name, const Cpub *c)
+{
+	fprintf(stderr,"\t%s: pc=0x%02x acc=0x%02x ix=0x%02x "
+			"cf=%d vf=%d nf=%d zf=%d\n",name,c->pc,c->acc,c->ix,
+			c->cf,c->vf,c->nf,c->zf);
+}
+
+int
+run_jit_check(Cpub *cpub, unsigned long long limit, unsigned long long *count)
+{
+	static Cpub		shadow;
+	IOBuf			ibuf;
+	IODev			idev, odev;
+	Uword			scratch[JIT_CHECK_SLICE + 1];
+	unsigned long long	total, slice, n, i;
+	int			result, addr;
+
+	total = 0;
+	result = RUN_STEP;
+	while( total < limit && result == RUN_STEP ) {
+		shadow = *cpub;
+		shadow.trace = NULL;
+		shadow.undo = NULL;
+		shadow.prof = NULL;
+		shadow.timing = NULL;
+		shadow.debug = NULL;
+		shadow.blocks = NULL;
+		memset(shadow.codemap,0,sizeof(shadow.codemap));
+		if( cpub->ibuf != NULL ) {
+			ibuf = *cpub->ibuf;
+			if( ibuf.dev != NULL ) {
+				iodev_reserve(ibuf.dev,JIT_CHECK_SLICE);
+				idev = *ibuf.dev;
+				idev.mapped = 1;	/* no reads */
+				ibuf.dev = &idev;
+			}
+			shadow.ibuf = &ibuf;
+		}
+		if( shadow.obuf.dev != NULL ) {
+			odev = *shadow.obuf.dev;
+			odev.buf = scratch;
+			odev.pos = 0;
+			odev.size = sizeof(scratch);	/* never full */
+			shadow.obuf.dev = &odev;
+		}
+
+		slice = limit - total;
+		if( slice > JIT_CHECK_SLICE )
+			slice = JIT_CHECK_SLICE;
+		result = run_jit(cpub,slice,&n);
+		for( i = 0 ; i < n ; i++ )
+			if( step(&shadow) == RUN_HALT )
+				break;
+
+		for( addr = 0 ; addr < MEMORY_SIZE ; addr++ )
+			if( cpub->mem[addr] != shadow.mem[addr] )
+				break;
+		if( cpub->pc != shadow.pc || cpub->acc != shadow.acc
+		 || cpub->ix != shadow.ix || cpub->cf != shadow.cf
+		 || cpub->vf != shadow.vf || cpub->nf != shadow.nf
+		 || cpub->zf != shadow.zf || addr < MEMORY_SIZE ) {
+			fprintf(stderr,"JIT mismatch within instructions "
+					"%llu-%llu:\n",total + 1,total + n);
+			print_state("jit ",cpub);
+			print_state("step",&shadow);
+			if( addr < MEMORY_SIZE )
+				fprintf(stderr,"\tmem[0x%03x]: jit=0x%02x "
+					"step=0x%02x\n",addr,cpub->mem[addr],
+					shadow.mem[addr]);
+			result = RUN_BREAK;
+		}
+		total += n;
+	}
+
+	if( count != NULL )
+		*count = total;
+	return result;
+}
@@ -0,0 +1,553 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	cpu-lanes.c
+ *	Descrioption:	lockstep engine for many boards (structure of arrays)
+ */
+
+#define	_POSIX_C_SOURCE	200809L	/* posix_memalign() */
+
+#include	<stdlib.h>
+#include	<string.h>
+#include	"cpuboard.h"
+#include	"lanes.h"
+
+
+/*=============================================================================
+ *   Allocation and Transfer of Boards
+ *===========================================================================*/
+Lanes *
+lanes_new(int n)
+{
+	Lanes	*L;
+	size_t	stride, size;
+	void	*p;
+
+	if( n <= 0 || (L = calloc(1,sizeof(Lanes))) == NULL )
+		return NULL;
+	L->n = n;
+	L->nvec = (n + LANE_VEC - 1) / LANE_VEC;
+	L->stride = stride = (size_t)L->nvec * LANE_VEC;
+
+	/* pc..zf, live, run, cnt8, mask, age, then the memory rows */
+	size = stride * (12 + MEMORY_SIZE);
+	if( posix_memalign(&p,LANE_VEC,size) != 0 ) {
+		free(L);
+		return NULL;
+	}
+	memset(p,0,size);
+	L->pc = p;
+	L->acc = L->pc + stride;
+	L->ix = L->acc + stride;
+	L->cf = L->ix + stride;
+	L->vf = L->cf + stride;
+	L->nf = L->vf + stride;
+	L->zf = L->nf + stride;
+	L->live = L->zf + stride;
+	L->run = L->live + stride;
+	L->cnt8 = L->run + stride;
+	L->mask = L->cnt8 + stride;
+	L->age = L->mask + stride;
+	L->mem = L->age + stride;
+
+	L->ibuf = calloc(n,sizeof(IOBuf));
+	L->obuf = calloc(n,sizeof(IOBuf));
+	L->count = calloc(n,sizeof(unsigned long long));
+	L->until = calloc(n,sizeof(unsigned long long));
+	if( L->ibuf == NULL || L->obuf == NULL || L->count == NULL
+	 || L->until == NULL ) {
+		lanes_free(L);
+		return NULL;
+	}
+	return L;
+}
+
+
+void
+lanes_free(Lanes *L)
+{
+	if( L == NULL )
+		return;
+	free(L->pc);
+	free(L->ibuf);
+	free(L->obuf);
+	free(L->count);
+	free(L->until);
+	free(L);
+}
+
+
+/* copy a board into lane k (it starts running) */
+void
+lanes_load(Lanes *L, int k, const Cpub *cpub)
+{
+	int	i;
+
+	L->pc[k] = cpub->pc;
+	L->acc[k] = cpub->acc;
+	L->ix[k] = cpub->ix;
+	L->cf[k] = cpub->cf;
+	L->vf[k] = cpub->vf;
+	L->nf[k] = cpub->nf;
+	L->zf[k] = cpub->zf;
+	L->live[k] = 0xff;
+	L->age[k] = 0;
+	L->cnt8[k] = 0;
+	L->count[k] = 0;
+	L->ibuf[k] = cpub->ibuf != NULL ? *cpub->ibuf : L->ibuf[k];
+	L->obuf[k] = cpub->obuf;
+	for( i = 0 ; i < MEMORY_SIZE ; i++ )
+		L->mem[i * L->stride + k] = cpub->mem[i];
+}
+
+
+/* copy lane k back into a board */
+void
+lanes_store(const Lanes *L, int k, Cpub *cpub)
+{
+	int	i;
+
+	cpub->pc = L->pc[k];
+	cpub->acc = L->acc[k];
+	cpub->ix = L->ix[k];
+	cpub->cf = L->cf[k];
+	cpub->vf = L->vf[k];
+	cpub->nf = L->nf[k];
+	cpub->zf = L->zf[k];
+	cpub->flag_op = FLAGS_VALID;
+	if( cpub->ibuf != NULL )
+		*cpub->ibuf = L->ibuf[k];
+	cpub->obuf = L->obuf[k];
+	for( i = 0 ; i < MEMORY_SIZE ; i++ )
+		cpub->mem[i] = L->mem[i * L->stride + k];
+}
+
+
+/*
+ *   Execute one instruction of lane k with step() (HLT, IN, OUT,
+ *   shift/rotate, unknown words); the lane stops when step() halts
+ */
+static void
+lane_step(Lanes *L, int k)
+{
+	static const Cpub	clear;
+	Cpub			c = clear;
+	unsigned long long	n = L->count[k];
+	unsigned char		n8 = L->cnt8[k];
+	int			halt;
+
+	lanes_store(L,k,&c);
+	c.ibuf = &L->ibuf[k];
+	halt = step(&c) == RUN_HALT;
+	lanes_load(L,k,&c);
+	L->live[k] = halt ? 0 : 0xff;
+	L->run[k] &= L->live[k];
+	L->count[k] = n;
+	L->cnt8[k] = n8;
+}
+
+
+#if defined(__GNUC__)
+
+/*=============================================================================
+ *   Vector Operations (GCC vector extensions, compiled for AVX2 where the
+ *   processor has it)
+ *===========================================================================*/
+typedef unsigned char	Vec __attribute__((vector_size(LANE_VEC)));
+
+#if defined(__x86_64__) && defined(__linux__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define	LANES_TARGET	__attribute__((target_clones("avx2","default")))
+#endif
+#endif
+#ifndef	LANES_TARGET
+#define	LANES_TARGET
+#endif
+
+#define	LANE_PATIENCE	64		/* steps a lane may wait to run */
+
+#define	V(p,v)		(((Vec *)(p))[v])
+#define	ROW(L,a)	((Vec *)((L)->mem + (size_t)(a) * (L)->stride))
+
+#define	TRUE(x)		((Vec)(x))		/* comparison to 0xff/0 */
+#define	BIT(x)		(TRUE(x) & 1)
+#define	BLEND(m,x,y)	(((m) & (x)) | (~(m) & (y)))
+#define	SIGN(x)		((x) >> 7)
+#define	VF(a,b,r)	SIGN(~((a) ^ (b)) & ((a) ^ (r)))
+#define	splat(x)	((Vec){0} + (unsigned char)(x))
+
+/* vectors are passed by address: the default clone has no AVX registers */
+static inline int
+any(const Vec *m)
+{
+	unsigned long long	w[LANE_VEC / 8];
+	int			i;
+
+	memcpy(w,m,sizeof(w));
+	for( i = 1 ; i < LANE_VEC / 8 ; i++ )
+		w[0] |= w[i];
+	return w[0] != 0;
+}
+
+/* are all running lanes at pc? */
+static inline int
+same_pc(const Lanes *L, Uword pc)
+{
+	Vec	m;
+	int	v;
+
+	for( v = 0 ; v < L->nvec ; v++ ) {
+		m = V(L->run,v) & TRUE(V(L->pc,v) != pc);
+		if( any(&m) )
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ *   Add cnt8[] to count[] and stop the lanes that have reached their
+ *   limit; returns the steps that may pass before the next call (no
+ *   lane runs more than one instruction a step, nor may cnt8[] wrap)
+ */
+static int
+lanes_fold(Lanes *L, int *stopped)
+{
+	unsigned long long	left;
+	int			k, safe = 0x80;
+
+	*stopped = 0;
+	for( k = 0 ; k < L->n ; k++ ) {
+		L->count[k] += L->cnt8[k], L->cnt8[k] = 0;
+		if( !L->run[k] )
+			continue;
+		if( L->count[k] >= L->until[k] ) {
+			L->run[k] = 0;
+			*stopped = 1;
+		} else if( (left = L->until[k] - L->count[k]) < (unsigned)safe )
+			safe = (int)left;
+	}
+	return safe;
+}
+
+
+/*
+ *   Operand B of the lanes of vector v and the row of its effective
+ *   address (NULL for the indexed modes, where it differs by lane)
+ */
+static inline void
+operand_b(Lanes *L, const InstructionInfo *inf, int v, Uword w2,
+						Vec *b, Vec **row)
+{
+	unsigned char	*ix = L->ix + v * LANE_VEC;
+	int		i, area;
+
+	*row = ROW(L,0) + v;	/* register/immediate: address 0x000 */
+	switch( inf->addr_mode_b ) {
+	   case ADDR_MODE_REG_ACC:	*b = V(L->acc,v); break;
+	   case ADDR_MODE_REG_IX:	*b = V(L->ix,v); break;
+	   case ADDR_MODE_IMMEDIATE:	*b = splat(w2); break;
+	   case ADDR_MODE_ABS_PROG:
+		*row = ROW(L,w2) + v;
+		*b = **row;
+		break;
+	   case ADDR_MODE_ABS_DATA:
+		*row = ROW(L,0x100 | w2) + v;
+		*b = **row;
+		break;
+	   default:
+		area = inf->addr_mode_b == ADDR_MODE_IX_DATA ? 0x100 : 0;
+		for( i = 0 ; i < LANE_VEC ; i++ )
+			(*b)[i] = L->mem[(area | (Uword)(ix[i] + w2))
+					* L->stride + v * LANE_VEC + i];
+		*row = NULL;
+		break;
+	}
+}
+
+
+/*=============================================================================
+ *   Run the Boards in Lockstep until All Halt or the Limit
+ *
+ *   Each step takes the lowest PC among the running lanes and executes
+ *   its instruction on every lane at that PC with the same instruction
+ *   words; the other lanes are masked off and wait.  Lanes that branch
+ *   apart thus meet again where their paths join.  So that a lane looping
+ *   at a low address does not hold up the others for ever, a lane that
+ *   has waited LANE_PATIENCE steps leads for as many.  The result and flags
+ *   follow execute_alu_operation() exactly; instructions other than
+ *   LD..EOR, Bbc, JAL, JR, NOP, RCF and SCF, and BNI/BNO, are executed
+ *   lane by lane with step().  limit applies to every lane on its own, as
+ *   if it ran alone; count[] has the instructions of every lane and
+ *   *count their sum in this call.
+ *===========================================================================*/
+LANES_TARGET int
+run_lanes(Lanes *L, unsigned long long limit, unsigned long long *count)
+{
+	const InstructionInfo	*inf;
+	unsigned long long	total = 0;
+	Vec			m, *row, a, b, r, c, t, *reg, *A, newpc;
+	Vec			*mask;
+	Uword			P = 0, w1, w2;
+	int			v, i, k, lead = -1, len, all, jump, slow;
+	int			stick = 0, old, turn = 0, safe, stopped;
+
+	if( count != NULL )
+		*count = 0;
+	if( L == NULL )
+		return RUN_HALT;
+	mask = (Vec *)L->mask;
+	for( k = 0 ; k < L->n ; k++ ) {
+		L->count[k] += L->cnt8[k], L->cnt8[k] = 0;
+		total -= L->count[k];
+		L->until[k] = L->count[k] + limit < L->count[k]
+				? ~0ULL : L->count[k] + limit;
+		L->run[k] = limit > 0 ? L->live[k] : 0;
+	}
+	safe = lanes_fold(L,&stopped);
+
+	for( ;; ) {
+		/*
+		 *   Leader: the first running lane with the lowest PC
+		 */
+		if( lead < 0 ) {
+			for( i = 0, old = -1 ; i < L->n ; i++ ) {
+				/* from after the last late lane, turn about */
+				if( (k = turn + i) >= L->n )
+					k -= L->n;
+				if( !L->run[k] )
+					continue;
+				if( lead < 0 || L->pc[k] < P )
+					lead = k, P = L->pc[k];
+				if( L->age[k] >= LANE_PATIENCE
+				 && (old < 0 || L->age[k] > L->age[old]) )
+					old = k;
+			}
+			if( lead < 0 )
+				break;		/* all halted or at the limit */
+			if( old >= 0 ) {
+				lead = old;
+				P = L->pc[old];
+				stick = LANE_PATIENCE;
+				turn = old + 1;
+			}
+		}
+		w1 = L->mem[P * L->stride + lead];
+		w2 = L->mem[(Uword)(P + 1) * L->stride + lead];
+		inf = &decode_table[w1];
+		len = inf->word_length;
+
+		/*
+		 *   Lanes taking part: at P with the same instruction words
+		 */
+		all = 1;
+		for( v = 0 ; v < L->nvec ; v++ ) {
+			m = V(L->run,v) & TRUE(V(L->pc,v) == P)
+					 & TRUE(ROW(L,P)[v] == w1);
+			if( len == 2 )
+				m &= TRUE(ROW(L,(Uword)(P + 1))[v] == w2);
+			mask[v] = m;
+			m ^= V(L->run,v);	/* running lanes left out */
+			if( any(&m) )
+				all = 0;
+		}
+
+		/*
+		 *   Execute
+		 */
+		jump = slow = 0;
+		switch( inf->type ) {
+		   case INST_NOP:
+			break;
+		   case INST_RCF:
+		   case INST_SCF:
+			for( v = 0 ; v < L->nvec ; v++ )
+				V(L->cf,v) = BLEND(mask[v],
+					splat(inf->type == INST_SCF),V(L->cf,v));
+			break;
+		   case INST_LD: case INST_ST:
+		   case INST_ADD: case INST_ADC: case INST_SUB: case INST_SBC:
+		   case INST_CMP: case INST_AND: case INST_OR: case INST_EOR:
+			if( inf->addr_mode_b == ADDR_MODE_NONE )
+				goto slow;
+			A = (Vec *)(inf->a_field ? L->ix : L->acc);
+			for( v = 0 ; v < L->nvec ; v++ ) {
+				m = mask[v];
+				if( !any(&m) )
+					continue;
+				operand_b(L,inf,v,w2,&b,&row);
+				reg = &A[v];
+				a = *reg;
+				if( inf->type == INST_LD ) {
+					*reg = BLEND(m,b,a);
+					continue;
+				}
+				if( inf->type == INST_ST ) {
+					if( row != NULL ) {
+						*row = BLEND(m,a,*row);
+						continue;
+					}
+					for( i = 0 ; i < LANE_VEC ; i++ )
+						if( m[i] )
+							L->mem[((inf->addr_mode_b
+							== ADDR_MODE_IX_DATA ? 0x100 : 0)
+							| (Uword)(L->ix[v*LANE_VEC+i]
+							+ w2)) * L->stride
+							+ v * LANE_VEC + i] = a[i];
+					continue;
+				}
+
+				c = V(L->cf,v);
+				switch( inf->type ) {
+				   case INST_ADD:
+				   case INST_ADC:		/* CF of a + b */
+					t = a + b;
+					r = inf->type == INST_ADC ? t + c : t;
+					c = BIT(t < a);
+					V(L->vf,v) = BLEND(m,VF(a,b,r),V(L->vf,v));
+					break;
+				   case INST_SUB:
+				   case INST_SBC:
+				   case INST_CMP:		/* VF of a + (-b) */
+					r = a - b;
+					if( inf->type == INST_SBC )
+						r -= c;
+					c = BIT(a >= b);
+					t = -b;
+					V(L->vf,v) = BLEND(m,VF(a,t,r),V(L->vf,v));
+					break;
+				   default:
+					r = inf->type == INST_AND ? (a & b)
+					  : inf->type == INST_OR  ? (a | b)
+					  :			    (a ^ b);
+					c = splat(0);
+					V(L->vf,v) = BLEND(m,splat(0),V(L->vf,v));
+					break;
+				}
+				V(L->cf,v) = BLEND(m,c,V(L->cf,v));
+				V(L->nf,v) = BLEND(m,SIGN(r),V(L->nf,v));
+				V(L->zf,v) = BLEND(m,BIT(r == 0),V(L->zf,v));
+				if( inf->type != INST_CMP )
+					*reg = BLEND(m,r,a);
+			}
+			break;
+		   case INST_Bbc:
+			if( inf->branch_cond == BRANCH_COND_NI
+			 || inf->branch_cond == BRANCH_COND_NO )
+				goto slow;
+			jump = 1;
+			for( v = 0 ; v < L->nvec ; v++ ) {
+				Vec	cf = V(L->cf,v), vf = V(L->vf,v);
+				Vec	nf = V(L->nf,v), zf = V(L->zf,v);
+
+				switch( inf->branch_cond ) {
+				   case BRANCH_COND_A:	t = splat(1); break;
+				   case BRANCH_COND_VF:	t = vf; break;
+				   case BRANCH_COND_NZ:	t = zf ^ 1; break;
+				   case BRANCH_COND_Z:	t = zf; break;
+				   case BRANCH_COND_ZP:	t = nf ^ 1; break;
+				   case BRANCH_COND_N:	t = nf; break;
+				   case BRANCH_COND_P:	t = (nf | zf) ^ 1; break;
+				   case BRANCH_COND_ZN:	t = nf | zf; break;
+				   case BRANCH_COND_NC:	t = cf ^ 1; break;
+				   case BRANCH_COND_C:	t = cf; break;
+				   case BRANCH_COND_GE:	t = (vf ^ nf) ^ 1; break;
+				   case BRANCH_COND_LT:	t = vf ^ nf; break;
+				   case BRANCH_COND_GT:	t = ((vf ^ nf) | zf) ^ 1; break;
+				   case BRANCH_COND_LE:	t = (vf ^ nf) | zf; break;
+				   default:		t = splat(0); break;
+				}
+				t = TRUE(t != 0);
+				newpc = BLEND(t,splat(w2),splat(P + 2));
+				V(L->pc,v) = BLEND(mask[v],newpc,V(L->pc,v));
+			}
+			break;
+		   case INST_JAL:
+			jump = 1;
+			A = (Vec *)(inf->a_field ? L->ix : L->acc);
+			for( v = 0 ; v < L->nvec ; v++ ) {
+				A[v] = BLEND(mask[v],splat(P + 2),A[v]);
+				V(L->pc,v) = BLEND(mask[v],splat(w2),V(L->pc,v));
+			}
+			break;
+		   case INST_JR:
+			jump = 1;
+			for( v = 0 ; v < L->nvec ; v++ )
+				V(L->pc,v) = BLEND(mask[v],V(L->acc,v),V(L->pc,v));
+			break;
+		   default:
+		   slow:
+			jump = slow = 1;
+			for( v = 0 ; v < L->nvec ; v++ )
+				for( i = 0 ; i < LANE_VEC ; i++ )
+					if( mask[v][i] ) {
+						L->cnt8[v*LANE_VEC+i]++;
+						lane_step(L,v * LANE_VEC + i);
+					}
+			break;
+		}
+
+		/*
+		 *   Advance the PC and the instruction counts of the lanes
+		 */
+		for( v = 0 ; v < L->nvec ; v++ ) {
+			if( !jump )
+				V(L->pc,v) = BLEND(mask[v],splat(P + len),
+								V(L->pc,v));
+			t = V(L->age,v);
+			V(L->age,v) = BLEND(mask[v],splat(0),t + BIT(t != 0xff));
+			if( !slow )		/* else counted above */
+				V(L->cnt8,v) -= mask[v];	/* += 1 */
+		}
+		if( --safe == 0 && (safe = lanes_fold(L,&stopped), stopped) ) {
+			lead = -1;		/* the leader may be among them */
+			stick = 0;
+			continue;
+		}
+
+		/* the same lanes go on together unless they (may) part */
+		if( stick > 0 && L->run[lead] ) {
+			stick--;
+			P = L->pc[lead];
+		} else if( all && !jump )
+			P = (Uword)(P + len);
+		else if( all && L->run[lead] && same_pc(L,L->pc[lead]) )
+			P = L->pc[lead];	/* all went the same way */
+		else
+			lead = -1;
+	}
+
+	lanes_fold(L,&stopped);
+	for( k = 0 ; k < L->n ; k++ )
+		total += L->count[k];
+	if( count != NULL )
+		*count = total;
+	for( k = 0 ; k < L->n ; k++ )
+		if( L->live[k] )
+			return RUN_STEP;
+	return RUN_HALT;
+}
+
+#else	/* !__GNUC__: one board after another */
+
+int
+run_lanes(Lanes *L, unsigned long long limit, unsigned long long *count)
+{
+	unsigned long long	n, total = 0;
+	int			k;
+
+	for( k = 0 ; L != NULL && k < L->n ; k++ ) {
+		for( n = 0 ; L->live[k] && n < limit ; n++ )
+			lane_step(L,k);
+		L->count[k] += n;
+		total += n;
+	}
+	if( count != NULL )
+		*count = total;
+	for( k = 0 ; L != NULL && k < L->n ; k++ )
+		if( L->live[k] )
+			return RUN_STEP;
+	return RUN_HALT;
+}
+
+#endif
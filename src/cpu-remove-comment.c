@@ -1,4 +1,9 @@
 #include "cpuboard.h"
+#include "trace.h"
+#include "debug.h"
+#include "undo.h"
+#include "profile.h"
+#include "timing.h"
 #include <stdio.h>
 
 // Instruction field extraction macros
@@ -6,7 +11,7 @@
 #define GET_A_FIELD(inst)          (((inst) >> 3) & 0x01)
 #define GET_B_FIELD(inst)          ((inst) & 0x07)
 #define GET_SHIFT_MODE(inst)       ((inst) & 0x03)
-#define GET_BRANCH_CONDITION(inst) (((inst) >> 4) & 0x0F)
+#define GET_BRANCH_CONDITION(inst) ((inst) & 0x0F)
 
 // Opcode prefixes
 #define NOP_HLT_OPCODE_PREFIX  0x00
@@ -28,38 +33,107 @@
 
 // Function prototypes
 static void fetch_instruction(Cpub *cpub, InstructionInfo *info);
-static void decode_instruction(Cpub *cpub, InstructionInfo *info);
+static void decode_instruction(InstructionInfo *info);
+static BranchCondition decode_branch_condition(Uword inst);
 static void fetch_operands(Cpub *cpub, InstructionInfo *info);
 static void execute_alu_operation(Cpub *cpub, InstructionInfo *info);
 static void write_back_result(Cpub *cpub, InstructionInfo *info);
 static void update_program_counter(Cpub *cpub, InstructionInfo *info);
-static void update_flags_for_arith_logic(Cpub *cpub, Uword old_val_a, Uword old_val_b, Uword alu_result, int is_sub);
+static void record_flags(Cpub *cpub, Uword old_val_a, Uword old_val_b, Uword alu_result, int kind);
+static int execute_instruction(Cpub *cpub);
+static void trace_record(TraceRecord *rec, Cpub *cpub, InstructionInfo *info, int halted);
 
+// Pre-decoded instruction templates, indexed by the 1st instruction word
+InstructionInfo decode_table[256];
 
-// Main instruction execution function
+
+// Build the decode table once; must be called before the first step()
+void init_decode_table(void)
+{
+   int inst;
+
+   for (inst = 0; inst < 256; inst++) {
+       InstructionInfo info = {0};
+
+       info.instruction_word_1st = inst;
+       info.a_field = GET_A_FIELD(inst);
+       info.b_field = GET_B_FIELD(inst);
+       info.type = INST_UNKNOWN;
+       info.addr_mode_b = ADDR_MODE_NONE;
+       info.shift_mode = SHIFT_MODE_NONE;
+       info.branch_cond = BRANCH_COND_NONE;
+       decode_instruction(&info);
+       info.word_length = (info.addr_mode_b == ADDR_MODE_NONE || info.addr_mode_b == ADDR_MODE_REG_ACC ||
+                           info.addr_mode_b == ADDR_MODE_REG_IX) ? 1 : 2;
+       // Clocks: phases P0-P2, one more for a 2nd word, one more for a memory operand
+       info.cycles = 3 + (info.word_length == 2) +
+                     (info.type >= INST_LD && info.type <= INST_EOR &&
+                      info.addr_mode_b >= ADDR_MODE_ABS_PROG && info.addr_mode_b <= ADDR_MODE_IX_DATA);
+       decode_table[inst] = info;
+   }
+}
+
+
+// Main instruction execution function (returns with the flags up to date)
 int step(Cpub *cpub)
 {
-   InstructionInfo info = {0};
+   int result = execute_instruction(cpub);
 
-   // 1. Instruction fetch
-   fetch_instruction(cpub, &info);
+   FlagSync(cpub);
+   return result;
+}
 
-   // 2. Instruction decode
-   decode_instruction(cpub, &info);
+// Execute one instruction, leaving the flags of ADD..EOR pending
+static int execute_instruction(Cpub *cpub)
+{
+   InstructionInfo info;
+   TraceRecord *rec = NULL;
+
+   // Binary trace: keep the state before the instruction
+   if (cpub->trace != NULL) {
+       FlagSync(cpub);
+       rec = TraceRingNext(cpub->trace);
+       rec->acc[0] = cpub->acc;
+       rec->ix[0] = cpub->ix;
+       rec->flags[0] = TRACE_FLAGS(cpub);
+   }
+
+   // Undo log: keep the registers before the instruction
+   if (cpub->undo != NULL) {
+       undo_begin(cpub);
+   }
+
+   TRACE_PHASE("DEBUG: --- Starting new instruction cycle ---\n");
+   TRACE_PHASE("DEBUG: Initial PC: 0x%03x\n", cpub->pc);
+
+   // 1. Instruction fetch and 2. decode (one lookup in the decode table)
+   fetch_instruction(cpub, &info);
    if (info.type == INST_UNKNOWN) {
        fprintf(stderr, "Error: Unknown instruction 0x%02x at 0x%03x\n", info.instruction_word_1st, info.pc_at_fetch);
+       if (rec != NULL) trace_record(rec, cpub, &info, 1);
+       if (cpub->undo != NULL) undo_end(cpub);
+       if (cpub->prof != NULL) prof_count(cpub->prof, &info);
+       if (cpub->timing != NULL) TimingCount(cpub->timing, &info);
        return RUN_HALT;
    }
 
    // Check for HLT instruction
    if (info.type == INST_HLT) {
        printf("HLT instruction executed. Program Halted.\n");
+       if (rec != NULL) trace_record(rec, cpub, &info, 1);
+       if (cpub->undo != NULL) undo_end(cpub);
+       if (cpub->prof != NULL) prof_count(cpub->prof, &info);
+       if (cpub->timing != NULL) TimingCount(cpub->timing, &info);
        return RUN_HALT;
    }
+   TRACE_PHASE("DEBUG: Instruction decoded as Type=%d (A_Field=%d, B_Field=%d, AddrModeB=%d)\n",
+               info.type, info.a_field, info.b_field, info.addr_mode_b);
 
    // 3. Operand fetch (if needed)
    if (info.addr_mode_b != ADDR_MODE_NONE) {
        fetch_operands(cpub, &info);
+       TRACE_PHASE("DEBUG: Operand fetched. OpA=0x%02x, OpB=0x%02x, Effective Address=0x%03x\n",
+                   info.operand_a_val, info.operand_b_val, info.effective_addr);
    } else if (info.type == INST_Bbc || info.type == INST_JAL || info.type == INST_JR) {
        if (info.type != INST_JR) {
            info.instruction_word_2nd = cpub->mem[cpub->pc];
@@ -75,31 +149,92 @@ int step(Cpub *cpub)
        info.type != INST_NOP && info.type != INST_RCF && info.type != INST_SCF && 
        info.type != INST_HLT && info.type != INST_IN && info.type != INST_OUT) {
        execute_alu_operation(cpub, &info);
+   } else {
+       TRACE_PHASE("DEBUG: ALU operation skipped for this instruction type: %d\n", info.type);
    }
 
    // 5. Write back results
+   if (cpub->undo != NULL && info.type == INST_ST) {
+       undo_store(cpub, info.effective_addr);
+   }
    write_back_result(cpub, &info);
+   TRACE_PHASE("DEBUG: Result write back completed.\n");
 
    // 6. Update program counter
    update_program_counter(cpub, &info);
+   TRACE_PHASE("DEBUG: Program Counter updated. Current PC: 0x%03x\n", cpub->pc);
 
+   TRACE_INST("DEBUG: PC=0x%03x Inst=0x%02x,0x%02x Type=%d -> PC=0x%03x ACC=0x%02x IX=0x%02x CF=%d VF=%d NF=%d ZF=%d\n",
+              info.pc_at_fetch, info.instruction_word_1st, info.instruction_word_2nd, info.type,
+              cpub->pc, cpub->acc, cpub->ix, cpub->cf, cpub->vf, cpub->nf, cpub->zf);
+   TRACE_PHASE("DEBUG: --- Instruction cycle completed. Final PC: 0x%03x ---\n", cpub->pc);
+
+   if (rec != NULL) trace_record(rec, cpub, &info, 0);
+   if (cpub->undo != NULL) undo_end(cpub);
+   if (cpub->prof != NULL) prof_count(cpub->prof, &info);
+   if (cpub->timing != NULL) TimingCount(cpub->timing, &info);
    return RUN_STEP;
 }
 
+// Complete a binary trace record with the state after the instruction
+static void trace_record(TraceRecord *rec, Cpub *cpub, InstructionInfo *info, int halted)
+{
+   rec->pc[0] = info->pc_at_fetch;
+   rec->pc[1] = cpub->pc;
+   rec->inst[0] = info->instruction_word_1st;
+   rec->inst[1] = info->instruction_word_2nd;
+   rec->acc[1] = cpub->acc;
+   rec->ix[1] = cpub->ix;
+   rec->flags[1] = TRACE_FLAGS(cpub);
+   rec->ea[0] = info->effective_addr & 0xFF;
+   rec->ea[1] = info->effective_addr >> 8;
+   rec->type = info->type;
+   rec->halted = halted;
+}
+
+// Run step() repeatedly until HLT/error, a break-point or watch-point hit, or until limit instructions have run
+int run_step(Cpub *cpub, unsigned long long limit, unsigned long long *count)
+{
+   unsigned long long n = 0;
+   int result = RUN_STEP;
+
+   while (n < limit) {
+       n++;
+       if (execute_instruction(cpub) == RUN_HALT) {
+           result = RUN_HALT;
+           break;
+       }
+       if (cpub->debug != NULL && cpub->debug->hit) {
+           result = RUN_BREAK;
+           break;
+       }
+       if (BrkTest(cpub->brkmap, cpub->pc)) {
+           FlagSync(cpub);
+           if (debug_break(cpub)) {
+               result = RUN_BREAK;
+               break;
+           }
+       }
+   }
+   FlagSync(cpub);
+   if (count != NULL) {
+       *count = n;
+   }
+   return result;
+}
+
 // Phase 1: Instruction Fetch
 static void fetch_instruction(Cpub *cpub, InstructionInfo *info) {
+   *info = decode_table[cpub->mem[cpub->pc]];
    info->pc_at_fetch = cpub->pc;
-   info->instruction_word_1st = cpub->mem[cpub->pc];
    cpub->pc++;
-
-   info->type = INST_UNKNOWN;
-   info->addr_mode_b = ADDR_MODE_NONE;
-   info->a_field = GET_A_FIELD(info->instruction_word_1st);
-   info->b_field = GET_B_FIELD(info->instruction_word_1st);
+   TRACE_PHASE("DEBUG(Phase 1): Fetched PC=0x%03x, Instruction=0x%02x\n", info->pc_at_fetch, info->instruction_word_1st);
+   TRACE_PHASE("DEBUG(Phase 2): Decoded from table: Type=%d, A_Field=%d, B_Field=%d, AddrModeB=%d\n",
+               info->type, info->a_field, info->b_field, info->addr_mode_b);
 }
  
-// Phase 2: Instruction Decode
-static void decode_instruction(Cpub *cpub, InstructionInfo *info)
+// Phase 2: Instruction Decode (used only to build decode_table)
+static void decode_instruction(InstructionInfo *info)
 {
     Uword op_prefix = GET_OPCODE_PREFIX(info->instruction_word_1st);
 
@@ -107,8 +242,6 @@ static void decode_instruction(Cpub *cpub, InstructionInfo *info)
         case NOP_HLT_OPCODE_PREFIX:
             if (info->instruction_word_1st == 0x00) { info->type = INST_NOP; }
             else if (info->instruction_word_1st == 0x0F) { info->type = INST_HLT; }
-            else if (info->instruction_word_1st == 0x10) { info->type = INST_OUT; }
-            else if (info->instruction_word_1st == 0x1F) { info->type = INST_IN; }
             else if (info->instruction_word_1st == 0x0A) {
                 info->type = INST_JAL; info->branch_cond = BRANCH_COND_NONE;
             }
@@ -118,6 +251,11 @@ static void decode_instruction(Cpub *cpub, InstructionInfo *info)
             else { info->type = INST_UNKNOWN; }
             break;
 
+        case OUT_IN_OPCODE_PREFIX:
+            // OUT 0001 0xxx, IN 0001 1xxx
+            info->type = (GET_A_FIELD(info->instruction_word_1st) == 0) ? INST_OUT : INST_IN;
+            break;
+
         case RCF_SCF_OPCODE_PREFIX:
             if (info->instruction_word_1st == 0x20) { info->type = INST_RCF; }
             else if (info->instruction_word_1st == 0x2F) { info->type = INST_SCF; }
@@ -141,6 +279,7 @@ static void decode_instruction(Cpub *cpub, InstructionInfo *info)
         }
         case BRANCH_OPCODE_PREFIX: {
             info->type = INST_Bbc;
+            info->branch_cond = decode_branch_condition(info->instruction_word_1st);
             break;
         }
         default: {
@@ -168,12 +307,36 @@ static void decode_instruction(Cpub *cpub, InstructionInfo *info)
             case 0x06: info->addr_mode_b = ADDR_MODE_IX_PROG; break;
             case 0x07: info->addr_mode_b = ADDR_MODE_IX_DATA; break;
             default: 
+                // Unexpected B field: no operand B (reported at write back)
                 info->addr_mode_b = ADDR_MODE_NONE; 
-                fprintf(stderr, "ERROR: Unexpected B_Field 0x%x for instruction type %d.\n", info->b_field, info->type);
         }
     }
 }
 
+// Map the bc field of a Bbc instruction to its branch condition
+static BranchCondition decode_branch_condition(Uword inst)
+{
+    switch (GET_BRANCH_CONDITION(inst)) {
+        case 0x00: return BRANCH_COND_A;  // BA (Always)
+        case 0x08: return BRANCH_COND_VF; // BVF (on oVerFlow)
+        case 0x01: return BRANCH_COND_NZ; // BNZ (on Not Zero, 0x31 of the sample)
+        case 0x09: return BRANCH_COND_Z;  // BZ (on Zero)
+        case 0x02: return BRANCH_COND_ZP; // BZP (on Zero or Positive)
+        case 0x0A: return BRANCH_COND_N;  // BN (on Negative)
+        case 0x03: return BRANCH_COND_P;  // BP (on Positive)
+        case 0x0B: return BRANCH_COND_ZN; // BZN (on Zero or Negative)
+        case 0x04: return BRANCH_COND_NI; // BNI (on No Input)
+        case 0x0C: return BRANCH_COND_NO; // BNO (on No Output)
+        case 0x05: return BRANCH_COND_NC; // BNC (on No Carry)
+        case 0x0D: return BRANCH_COND_C;  // BC (on Carry)
+        case 0x06: return BRANCH_COND_GE; // BGE (on Greater than or Equal)
+        case 0x0E: return BRANCH_COND_LT; // BLT (on Less Than)
+        case 0x07: return BRANCH_COND_GT; // BGT (on Greater Than)
+        case 0x0F: return BRANCH_COND_LE; // BLE (on Less than or Equal)
+        default:   return BRANCH_COND_NONE;
+    }
+}
+
 // Phase 3: Operand Fetch
 static void fetch_operands(Cpub *cpub, InstructionInfo *info) {
    // Read operand A value (always from register)
@@ -227,6 +390,9 @@ static void fetch_operands(Cpub *cpub, InstructionInfo *info) {
            info->type = INST_UNKNOWN;
            break;
    }
+   TRACE_PHASE("DEBUG(Phase 3): Operand A value: 0x%02x (from %s).\n", info->operand_a_val, (info->a_field == 0) ? "ACC" : "IX");
+   TRACE_PHASE("DEBUG(Phase 3): OpB=0x%02x (AddrModeB=%d, 2nd word=0x%02x, EA=0x%03x).\n",
+               info->operand_b_val, info->addr_mode_b, info->instruction_word_2nd, info->effective_addr);
 }
 
 
@@ -236,46 +402,44 @@ static void execute_alu_operation(Cpub *cpub, InstructionInfo *info) {
    Uword old_val_b = info->operand_b_val;
    info->alu_result = 0;
 
+   TRACE_PHASE("DEBUG(Phase 4): Executing instruction type %d.\n", info->type);
    switch (info->type) {
        case INST_ADD:
            info->alu_result = old_val_a + old_val_b;
-           update_flags_for_arith_logic(cpub, old_val_a, old_val_b, info->alu_result, 0);
+           record_flags(cpub, old_val_a, old_val_b, info->alu_result, FLAGS_ADD);
            break;
        case INST_ADC:
+           FlagSync(cpub);
            info->alu_result = old_val_a + old_val_b + cpub->cf;
-           update_flags_for_arith_logic(cpub, old_val_a, old_val_b, info->alu_result, 0);
+           record_flags(cpub, old_val_a, old_val_b, info->alu_result, FLAGS_ADD);
            break;
        case INST_SUB:
            info->alu_result = old_val_a - old_val_b;
-           update_flags_for_arith_logic(cpub, old_val_a, old_val_b, info->alu_result, 1);
+           record_flags(cpub, old_val_a, old_val_b, info->alu_result, FLAGS_SUB);
            break;
        case INST_SBC:
+           FlagSync(cpub);
            info->alu_result = old_val_a - old_val_b - cpub->cf;
-           update_flags_for_arith_logic(cpub, old_val_a, old_val_b, info->alu_result, 1);
+           record_flags(cpub, old_val_a, old_val_b, info->alu_result, FLAGS_SUB);
            break;
        case INST_CMP:
            info->alu_result = old_val_a - old_val_b;
-           update_flags_for_arith_logic(cpub, old_val_a, old_val_b, info->alu_result, 1);
+           record_flags(cpub, old_val_a, old_val_b, info->alu_result, FLAGS_SUB);
            break;
        case INST_AND:
            info->alu_result = old_val_a & old_val_b;
-           cpub->cf = 0; cpub->vf = 0;
-           cpub->zf = (info->alu_result == 0) ? 1 : 0;
-           cpub->nf = (info->alu_result & 0x80) ? 1 : 0;
+           record_flags(cpub, old_val_a, old_val_b, info->alu_result, FLAGS_LOGIC);
            break;
        case INST_OR:
            info->alu_result = old_val_a | old_val_b;
-           cpub->cf = 0; cpub->vf = 0;
-           cpub->zf = (info->alu_result == 0) ? 1 : 0;
-           cpub->nf = (info->alu_result & 0x80) ? 1 : 0;
+           record_flags(cpub, old_val_a, old_val_b, info->alu_result, FLAGS_LOGIC);
            break;
        case INST_EOR:
            info->alu_result = old_val_a ^ old_val_b;
-           cpub->cf = 0; cpub->vf = 0;
-           cpub->zf = (info->alu_result == 0) ? 1 : 0;
-           cpub->nf = (info->alu_result & 0x80) ? 1 : 0;
+           record_flags(cpub, old_val_a, old_val_b, info->alu_result, FLAGS_LOGIC);
            break;
        case INST_Ssm:
+            FlagSync(cpub);     // VF is kept
             if (info->shift_mode == SHIFT_MODE_SRA) {
                 cpub->cf = (old_val_a & 0x01) ? 1 : 0;
                 info->alu_result = ((Sword)old_val_a >> 1);
@@ -284,6 +448,7 @@ static void execute_alu_operation(Cpub *cpub, InstructionInfo *info) {
             } else { fprintf(stderr, "Unsupported Shift Mode: %d\n", info->shift_mode); info->type = INST_UNKNOWN; }
             break;
        case INST_Rsm:
+            FlagSync(cpub);
             if (info->shift_mode == SHIFT_MODE_RLL) {
                 cpub->cf = (old_val_a & 0x80) ? 1 : 0;
                 info->alu_result = (old_val_a << 1) | cpub->cf;
@@ -294,38 +459,65 @@ static void execute_alu_operation(Cpub *cpub, InstructionInfo *info) {
        default:
            break;
    }
+   TRACE_PHASE("DEBUG(Phase 4): ALU result=0x%02x. Current Flags: CF=%d, VF=%d, NF=%d, ZF=%d\n",
+               info->alu_result, cpub->cf, cpub->vf, cpub->nf, cpub->zf);
 }
 
 
-// Helper: Update flags for arithmetic/logic operations
-static void update_flags_for_arith_logic(Cpub *cpub, Uword old_val_a, Uword old_val_b, Uword alu_result, int is_sub) {
+// Helper: Record an arithmetic/logic operation; its flags are computed by flag_sync() when read
+static void record_flags(Cpub *cpub, Uword old_val_a, Uword old_val_b, Uword alu_result, int kind) {
+   TRACE_PHASE("DEBUG(Flags Update): Recording flags for OpA=0x%02x, OpB=0x%02x, Result=0x%02x, Kind=%d\n",
+               old_val_a, old_val_b, alu_result, kind);
+   cpub->flag_op = kind;
+   cpub->flag_a = old_val_a;
+   cpub->flag_b = old_val_b;
+   cpub->flag_r = alu_result;
+
+   // Trace output shows the flags after every instruction
+   if (TRACE_ENABLED() || cpub->trace != NULL) {
+       flag_sync(cpub);
+   }
+}
+
+
+// Materialize the flags of the last ADD..EOR (see FlagSync())
+void flag_sync(Cpub *cpub) {
+   Uword old_val_a = cpub->flag_a;
+   Uword old_val_b = cpub->flag_b;
+   Uword alu_result = cpub->flag_r;
+
    // Zero Flag
    cpub->zf = (alu_result == 0) ? 1 : 0;
 
    // Negative Flag
    cpub->nf = (alu_result & 0x80) ? 1 : 0;
 
-   // Carry/Borrow Flag
-   if (!is_sub) {
-       cpub->cf = (((unsigned int)old_val_a + (unsigned int)old_val_b) > 0xFF) ? 1 : 0;
-   } else {
-       unsigned int temp_b = (unsigned int)~old_val_b;
-       unsigned int sum = (unsigned int)old_val_a + temp_b + 1;
-       cpub->cf = !((sum >> 8) & 0x01);
-   }
-
-   // Overflow Flag
-   if (!is_sub) {
-       cpub->vf = (((old_val_a & 0x80) == (old_val_b & 0x80)) && ((old_val_a & 0x80) != (alu_result & 0x80))) ? 1 : 0;
-   } else {
-       Uword neg_b = ~old_val_b + 1;
-       cpub->vf = (((old_val_a & 0x80) == (neg_b & 0x80)) && ((old_val_a & 0x80) != (alu_result & 0x80))) ? 1 : 0;
+   switch (cpub->flag_op) {
+       case FLAGS_ADD:
+           // Carry from a + b (a carry-in does not set it)
+           cpub->cf = (((unsigned int)old_val_a + (unsigned int)old_val_b) > 0xFF) ? 1 : 0;
+           cpub->vf = (((old_val_a & 0x80) == (old_val_b & 0x80)) && ((old_val_a & 0x80) != (alu_result & 0x80))) ? 1 : 0;
+           break;
+       case FLAGS_SUB: {
+           // No borrow from a - b; overflow as for a + (-b)
+           Uword neg_b = ~old_val_b + 1;
+           cpub->cf = (old_val_a >= old_val_b) ? 1 : 0;
+           cpub->vf = (((old_val_a & 0x80) == (neg_b & 0x80)) && ((old_val_a & 0x80) != (alu_result & 0x80))) ? 1 : 0;
+           break;
+       }
+       default:
+           cpub->cf = 0;
+           cpub->vf = 0;
+           break;
    }
+   cpub->flag_op = FLAGS_VALID;
+   TRACE_PHASE("DEBUG(Flags Update): Final Flags: CF=%d, VF=%d, NF=%d, ZF=%d\n", cpub->cf, cpub->vf, cpub->nf, cpub->zf);
 }
 
 
 // Phase 5: Write Back Result
 static void write_back_result(Cpub *cpub, InstructionInfo *info) {
+   TRACE_PHASE("DEBUG(Phase 5): Entering write_back_result for type %d.\n", info->type);
    switch (info->type) {
        case INST_LD:
            // Load operand B value to register A
@@ -347,6 +539,7 @@ static void write_back_result(Cpub *cpub, InstructionInfo *info) {
            // Write ALU result to register A
            if (info->result_dest_reg_ptr != NULL) {
                *(info->result_dest_reg_ptr) = info->alu_result;
+               TRACE_PHASE("DEBUG(Phase 5): Wrote ALU result 0x%02x to Reg A (Type %d).\n", info->alu_result, info->type);
            } else {
                fprintf(stderr, "Error: result_dest_reg_ptr is NULL for type %d.\n", info->type);
            }
@@ -356,6 +549,9 @@ static void write_back_result(Cpub *cpub, InstructionInfo *info) {
            if (info->result_dest_reg_ptr != NULL) {
                 Uword data_to_store = *(info->result_dest_reg_ptr);
                 cpub->mem[info->effective_addr] = data_to_store;
+                CodeWrite(cpub, info->effective_addr);
+                DebugWatch(cpub, info->effective_addr);
+                TRACE_PHASE("DEBUG(Phase 5): Stored 0x%02x (from Reg A) to Memory address 0x%03x.\n", data_to_store, info->effective_addr);
            } else {
                fprintf(stderr, "Error: result_dest_reg_ptr is NULL for ST instruction.\n");
            }
@@ -365,12 +561,24 @@ static void write_back_result(Cpub *cpub, InstructionInfo *info) {
            break;
        case INST_RCF:
            // Reset Carry Flag
+           FlagSync(cpub);
            cpub->cf = 0;
            break;
        case INST_SCF:
            // Set Carry Flag
+           FlagSync(cpub);
            cpub->cf = 1;
            break;
+       case INST_OUT:
+           // Output ACC to OBUF and raise its flag
+           iobuf_put(&cpub->obuf, cpub->acc);
+           TRACE_PHASE("DEBUG(Phase 5): OUT 0x%02x.\n", cpub->acc);
+           break;
+       case INST_IN:
+           // Input IBUF to ACC and lower its flag
+           cpub->acc = iobuf_take(cpub->ibuf);
+           TRACE_PHASE("DEBUG(Phase 5): IN 0x%02x.\n", cpub->acc);
+           break;
        case INST_JAL:
            // Store PC+2 to ACC
            if (info->result_dest_reg_ptr != NULL) {
@@ -389,26 +597,29 @@ static void write_back_result(Cpub *cpub, InstructionInfo *info) {
 static void update_program_counter(Cpub *cpub, InstructionInfo *info) {
     switch (info->type) {
         case INST_Bbc:
-            switch (GET_BRANCH_CONDITION(info->instruction_word_1st)) {
-                case 0x00: info->is_branch_taken = 1; break; // BA (Always)
-                case 0x08: info->is_branch_taken = cpub->vf; break; // BVF (on oVerFlow)
-                case 0x09: info->is_branch_taken = (cpub->zf == 1); break; // BZ (on Zero)
-                case 0x04: info->is_branch_taken = (cpub->nf == 0); break; // BZP (on Zero or Positive)
-                case 0x03: // BNZ from sample (0x31)
-                case 0x02: // BNZ (on Not Zero)
-                    info->is_branch_taken = (cpub->zf == 0);
-                    break;
-                case 0x06: info->is_branch_taken = ((cpub->nf == 0) && (cpub->zf == 0)); break; // BP (on Positive)
-                case 0x0B: info->is_branch_taken = ((cpub->nf == 1) || (cpub->zf == 1)); break; // BZN (on Zero or Negative)
-                case 0x05: info->is_branch_taken = (cpub->cf == 0); break; // BNC (on No Carry)
-                case 0x0D: info->is_branch_taken = (cpub->cf == 1); break; // BC (on Carry)
-                case 0x0A: info->is_branch_taken = ((cpub->vf ^ cpub->nf) == 0); break; // BGE (on Greater than or Equal)
-                case 0x0E: info->is_branch_taken = ((cpub->vf ^ cpub->nf) == 1); break; // BLT (on Less Than)
-                case 0x07: info->is_branch_taken = (((cpub->vf ^ cpub->nf) == 0) && (cpub->zf == 0)); break; // BGT (on Greater Than)
-                case 0x0F: info->is_branch_taken = (((cpub->vf ^ cpub->nf) == 1) || (cpub->zf == 1)); break; // BLE (on Less Than or Equal)
+            FlagSync(cpub);
+            switch (info->branch_cond) {
+                case BRANCH_COND_A:  info->is_branch_taken = 1; break;
+                case BRANCH_COND_VF: info->is_branch_taken = cpub->vf; break;
+                case BRANCH_COND_Z:  info->is_branch_taken = (cpub->zf == 1); break;
+                case BRANCH_COND_ZP: info->is_branch_taken = (cpub->nf == 0); break;
+                case BRANCH_COND_N:  info->is_branch_taken = (cpub->nf == 1); break;
+                case BRANCH_COND_NZ: info->is_branch_taken = (cpub->zf == 0); break;
+                case BRANCH_COND_P:  info->is_branch_taken = ((cpub->nf == 0) && (cpub->zf == 0)); break;
+                case BRANCH_COND_ZN: info->is_branch_taken = ((cpub->nf == 1) || (cpub->zf == 1)); break;
+                case BRANCH_COND_NI: info->is_branch_taken = !iobuf_ready(cpub->ibuf); break;
+                case BRANCH_COND_NO: info->is_branch_taken = iobuf_ready(&cpub->obuf); break;
+                case BRANCH_COND_NC: info->is_branch_taken = (cpub->cf == 0); break;
+                case BRANCH_COND_C:  info->is_branch_taken = (cpub->cf == 1); break;
+                case BRANCH_COND_GE: info->is_branch_taken = ((cpub->vf ^ cpub->nf) == 0); break;
+                case BRANCH_COND_LT: info->is_branch_taken = ((cpub->vf ^ cpub->nf) == 1); break;
+                case BRANCH_COND_GT: info->is_branch_taken = (((cpub->vf ^ cpub->nf) == 0) && (cpub->zf == 0)); break;
+                case BRANCH_COND_LE: info->is_branch_taken = (((cpub->vf ^ cpub->nf) == 1) || (cpub->zf == 1)); break;
                 default: info->is_branch_taken = 0; break;
             }
 
+            TRACE_PHASE("DEBUG(Phase 6): Branch condition %d: %s.\n", info->branch_cond,
+                        info->is_branch_taken ? "taken" : "not taken");
             if (info->is_branch_taken) {
                 cpub->pc = info->effective_addr;
             }
@@ -0,0 +1,216 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	cpu-threaded.c
+ *	Descrioption:	threaded-code (computed goto) execution engine
+ */
+
+#include	<stddef.h>
+#include	"cpuboard.h"
+#include	"trace.h"
+#include	"debug.h"
+#include	"engine.h"
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic ignored "-Wpedantic"	/* &&label, goto *ptr */
+
+
+/*=============================================================================
+ *   Operand B Access (one macro per addressing mode)
+ *
+ *   Mirrors fetch_operands() in the step() engine, including its quirks:
+ *   register and immediate modes leave the effective address at 0x000.
+ *===========================================================================*/
+#define	OPB_ACC		ea = 0, b = acc
+#define	OPB_IX		ea = 0, b = ix
+#define	OPB_IMM		ea = 0, b = mem[pc++]
+#define	OPB_ABSP	ea = mem[pc++], b = mem[ea]
+#define	OPB_ABSD	ea = 0x100 | mem[pc++], b = mem[ea]
+#define	OPB_IXP		ea = (Uword)(ix + mem[pc++]), b = mem[ea]
+#define	OPB_IXD		ea = 0x100 | (Uword)(ix + mem[pc++]), b = mem[ea]
+
+
+/*=============================================================================
+ *   Handler Generation: one label per (operation, register A, mode B)
+ *===========================================================================*/
+#define	NEXT		do {						\
+				--left;					\
+				if( BrkTest(brkmap,pc) ) goto brk;	\
+				if( left == 0 ) goto stop;		\
+				goto *dispatch[mem[pc++]];		\
+			} while(0)
+
+#define	HANDLER(OP,X,R,M)	OP##_##X##_##M: OPB_##M; OP_##OP(R); NEXT;
+
+/* a store into translated program words invalidates those translations */
+#undef	OP_ST
+#define	OP_ST(R)	mem[ea] = R, CodeWrite(cpub,ea)
+
+
+/*=============================================================================
+ *   Run a Program until HLT, an Error, a Break-point, or the Limit
+ *
+ *   The architectural registers live in locals while running and are
+ *   written back to the Cpub on exit.  Instructions without a fast handler
+ *   (HLT, unknown words, shift/rotate, malformed B fields) are executed by
+ *   step() itself, so diagnostics and halting behave exactly as in step().
+ *   Break-points (Cpub::brkmap) are checked after every instruction; a
+ *   conditional one is resolved by debug_break() only when its bit is set.
+ *   Armed watch-points route the whole run through step(), so ST needs no
+ *   watch test here.
+ *===========================================================================*/
+int
+run_threaded(Cpub *cpub, unsigned long long limit, unsigned long long *count)
+{
+	/* indexed by [type - INST_LD][A field][addressing mode] */
+	static void *const	op_labels[ENGINE_OPS][2][7] = {
+		LABELS(LD), LABELS(ST), LABELS(ADD), LABELS(ADC),
+		LABELS(SUB), LABELS(SBC), LABELS(CMP), LABELS(AND),
+		LABELS(OR), LABELS(EOR)
+	};
+	/* indexed by BranchCondition */
+	static void *const	br_labels[BRANCH_COND_NONE + 1] = {
+		&&B_A, &&B_VF, &&B_NZ, &&B_Z, &&B_ZP, &&B_N, &&B_P,
+		&&B_ZN, &&B_NI, &&B_NO, &&B_NC, &&B_C, &&B_GE,
+		&&B_LT, &&B_GT, &&B_LE, &&B_NEVER
+	};
+	static void		*dispatch[256];
+	static int		dispatch_ready = 0;
+
+	Uword			*mem;
+	const Uword		*brkmap;
+	Uword			pc, acc, ix, a, b, r;
+	Bit			cf, vf, nf, zf;
+	Addr			ea;
+	unsigned long long	left;
+	int			i, result;
+
+	/*
+	 *   Bind every instruction word to its handler (first call only)
+	 */
+	if( !dispatch_ready ) {
+		for( i = 0 ; i < 256 ; i++ ) {
+			const InstructionInfo	*e = &decode_table[i];
+
+			switch( e->type ) {
+			   case INST_NOP:	dispatch[i] = &&NOP; break;
+			   case INST_RCF:	dispatch[i] = &&RCF; break;
+			   case INST_SCF:	dispatch[i] = &&SCF; break;
+			   case INST_IN:	dispatch[i] = &&IN; break;
+			   case INST_OUT:	dispatch[i] = &&OUT; break;
+			   case INST_JR:	dispatch[i] = &&JR; break;
+			   case INST_JAL:
+				dispatch[i] = e->a_field ? &&JAL_X : &&JAL_A;
+				break;
+			   case INST_Bbc:
+				dispatch[i] = br_labels[e->branch_cond];
+				break;
+			   case INST_LD: case INST_ST:
+			   case INST_ADD: case INST_ADC: case INST_SUB:
+			   case INST_SBC: case INST_CMP: case INST_AND:
+			   case INST_OR: case INST_EOR:
+				if( e->addr_mode_b == ADDR_MODE_NONE )
+					dispatch[i] = &&SLOW;
+				else
+					dispatch[i] = op_labels[e->type - INST_LD]
+						[e->a_field][e->addr_mode_b];
+				break;
+			   default:		dispatch[i] = &&SLOW; break;
+			}
+		}
+		dispatch_ready = 1;
+	}
+
+	if( count != NULL )
+		*count = 0;
+	if( cpub == NULL || limit == 0 )
+		return RUN_STEP;
+	if( TRACE_ENABLED() || cpub->trace != NULL	/* traced by step() */
+	 || cpub->undo != NULL				/* logged by step() */
+	 || cpub->prof != NULL || cpub->timing != NULL	/* counted by step() */
+	 || (cpub->debug != NULL && cpub->debug->nwatch > 0) )
+		return run_step(cpub,limit,count);
+
+	mem = cpub->mem;
+	brkmap = cpub->brkmap;
+	pc = cpub->pc; acc = cpub->acc; ix = cpub->ix;
+	cf = cpub->cf; vf = cpub->vf; nf = cpub->nf; zf = cpub->zf;
+	left = limit;
+	result = RUN_STEP;
+	a = b = r = 0;
+	ea = 0;
+
+	goto *dispatch[mem[pc++]];
+
+	HANDLERS(LD)  HANDLERS(ST)  HANDLERS(ADD) HANDLERS(ADC)
+	HANDLERS(SUB) HANDLERS(SBC) HANDLERS(CMP) HANDLERS(AND)
+	HANDLERS(OR)  HANDLERS(EOR)
+
+     NOP:	NEXT;
+     RCF:	cf = 0; NEXT;
+     SCF:	cf = 1; NEXT;
+     IN:	acc = iobuf_take(cpub->ibuf); NEXT;
+     OUT:	iobuf_put(&cpub->obuf,acc); NEXT;
+     JR:	pc = acc; NEXT;
+     JAL_A:	ea = mem[pc++]; acc = pc; pc = ea; NEXT;	/* PC+2 */
+     JAL_X:	ea = mem[pc++]; ix = pc; pc = ea; NEXT;
+
+     B_A:	pc = mem[pc]; NEXT;
+     B_VF:	pc = vf ? mem[pc] : pc + 1; NEXT;
+     B_NZ:	pc = !zf ? mem[pc] : pc + 1; NEXT;
+     B_Z:	pc = zf ? mem[pc] : pc + 1; NEXT;
+     B_ZP:	pc = !nf ? mem[pc] : pc + 1; NEXT;
+     B_N:	pc = nf ? mem[pc] : pc + 1; NEXT;
+     B_P:	pc = (!nf && !zf) ? mem[pc] : pc + 1; NEXT;
+     B_ZN:	pc = (nf || zf) ? mem[pc] : pc + 1; NEXT;
+     B_NI:	pc = !iobuf_ready(cpub->ibuf) ? mem[pc] : pc + 1; NEXT;
+     B_NO:	pc = iobuf_ready(&cpub->obuf) ? mem[pc] : pc + 1; NEXT;
+     B_NC:	pc = !cf ? mem[pc] : pc + 1; NEXT;
+     B_C:	pc = cf ? mem[pc] : pc + 1; NEXT;
+     B_GE:	pc = !(vf ^ nf) ? mem[pc] : pc + 1; NEXT;
+     B_LT:	pc = (vf ^ nf) ? mem[pc] : pc + 1; NEXT;
+     B_GT:	pc = (!(vf ^ nf) && !zf) ? mem[pc] : pc + 1; NEXT;
+     B_LE:	pc = ((vf ^ nf) || zf) ? mem[pc] : pc + 1; NEXT;
+     B_NEVER:	pc++; NEXT;
+
+     SLOW:
+	cpub->pc = pc - 1; cpub->acc = acc; cpub->ix = ix;
+	cpub->cf = cf; cpub->vf = vf; cpub->nf = nf; cpub->zf = zf;
+	if( step(cpub) == RUN_HALT ) {
+		left--;
+		result = RUN_HALT;
+		goto done;
+	}
+	pc = cpub->pc; acc = cpub->acc; ix = cpub->ix;
+	cf = cpub->cf; vf = cpub->vf; nf = cpub->nf; zf = cpub->zf;
+	NEXT;
+
+     brk:
+	cpub->pc = pc; cpub->acc = acc; cpub->ix = ix;
+	cpub->cf = cf; cpub->vf = vf; cpub->nf = nf; cpub->zf = zf;
+	if( debug_break(cpub) ) {
+		result = RUN_BREAK;
+		goto done;
+	}
+	if( left == 0 )
+		goto done;
+	goto *dispatch[mem[pc++]];
+     stop:
+	cpub->pc = pc; cpub->acc = acc; cpub->ix = ix;
+	cpub->cf = cf; cpub->vf = vf; cpub->nf = nf; cpub->zf = zf;
+     done:
+	if( count != NULL )
+		*count = limit - left;
+	return result;
+}
+
+#else	/* !__GNUC__: no computed goto, fall back to step() */
+
+int
+run_threaded(Cpub *cpub, unsigned long long limit, unsigned long long *count)
+{
+	return run_step(cpub,limit,count);
+}
+
+#endif
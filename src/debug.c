@@ -0,0 +1,154 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	debug.c
+ *	Descrioption:	conditional break-points and data watch-points
+ */
+
+#include	<stdlib.h>
+#include	<string.h>
+#include	"debug.h"
+
+
+static const char	*reg_names[] = { "acc", "ix", "cf", "vf", "nf", "zf" };
+static const char	*op_names[] = { "==", "!=", "<", ">", "<=", ">=" };
+
+
+/*=============================================================================
+ *   Get the Debug Points of a Board (allocated on first use)
+ *===========================================================================*/
+DebugPoints *
+debug_points(Cpub *cpub)
+{
+	if( cpub->debug == NULL )
+		cpub->debug = calloc(1,sizeof(DebugPoints));
+	return cpub->debug;
+}
+
+
+/*=============================================================================
+ *   Decide Whether the Break-point at the Current PC Stops Execution
+ *
+ *   Called by the engines only when the brkmap bit of the PC is set.
+ *   Returns non-zero for an unconditional break-point or when any of the
+ *   conditions of the address holds.
+ *===========================================================================*/
+int
+debug_break(Cpub *cpub)
+{
+	const DebugPoints	*dp = cpub->debug;
+	const BrkCond		*c;
+	int			i, v;
+
+	if( dp == NULL || !BrkTest(dp->condmap,cpub->pc) )
+		return 1;
+
+	for( i = 0 ; i < dp->ncond ; i++ ) {
+		c = &dp->cond[i];
+		if( c->addr != cpub->pc )
+			continue;
+		switch( c->reg ) {
+		   case DBG_REG_ACC:	v = cpub->acc; break;
+		   case DBG_REG_IX:	v = cpub->ix; break;
+		   case DBG_REG_CF:	v = cpub->cf; break;
+		   case DBG_REG_VF:	v = cpub->vf; break;
+		   case DBG_REG_NF:	v = cpub->nf; break;
+		   default:		v = cpub->zf; break;
+		}
+		switch( c->op ) {
+		   case DBG_OP_EQ:	if( v == c->value ) return 1; break;
+		   case DBG_OP_NE:	if( v != c->value ) return 1; break;
+		   case DBG_OP_LT:	if( v <  c->value ) return 1; break;
+		   case DBG_OP_GT:	if( v >  c->value ) return 1; break;
+		   case DBG_OP_LE:	if( v <= c->value ) return 1; break;
+		   default:		if( v >= c->value ) return 1; break;
+		}
+	}
+	return 0;
+}
+
+
+/*=============================================================================
+ *   Parse a Condition "<reg><op><value(hex)>"  (the address is not set)
+ *
+ *   Returns 0 on success and -1 for a malformed condition.
+ *===========================================================================*/
+int
+debug_cond_parse(const char *str, BrkCond *c)
+{
+	size_t		len;
+	unsigned int	value;
+	char		tail;
+	int		i;
+
+	for( i = sizeof(reg_names)/sizeof(reg_names[0]) - 1 ; i >= 0 ; i-- ) {
+		len = strlen(reg_names[i]);
+		if( !strncmp(str,reg_names[i],len) )
+			break;
+	}
+	if( i < 0 )
+		return -1;
+	c->reg = i;
+	str += len;
+
+	/* two-character operators first so that "<=" is not read as "<" */
+	for( i = sizeof(op_names)/sizeof(op_names[0]) - 1 ; i >= 0 ; i-- ) {
+		len = strlen(op_names[i]);
+		if( !strncmp(str,op_names[i],len) )
+			break;
+	}
+	if( i < 0 )
+		return -1;
+	c->op = i;
+	str += len;
+
+	if( sscanf(str,"%x%c",&value,&tail) != 1 || value > 0xff )
+		return -1;
+	if( c->reg >= DBG_REG_CF && value > 1 )
+		return -1;
+	c->value = value;
+	return 0;
+}
+
+
+void
+debug_cond_print(FILE *fp, const BrkCond *c)
+{
+	fprintf(fp,"%s%s%x",reg_names[c->reg],op_names[c->op],c->value);
+}
+
+
+/*=============================================================================
+ *   Add a Condition to the Break-point at c->addr, or Remove All of Them
+ *
+ *   debug_cond_add() returns 0 on success and -1 when the table is full.
+ *===========================================================================*/
+int
+debug_cond_add(Cpub *cpub, const BrkCond *c)
+{
+	DebugPoints	*dp;
+
+	if( (dp = debug_points(cpub)) == NULL || dp->ncond >= BRK_COND_MAX )
+		return -1;
+	dp->cond[dp->ncond++] = *c;
+	BrkSet(dp->condmap,c->addr);
+	BrkSet(cpub->brkmap,c->addr);
+	return 0;
+}
+
+
+void
+debug_cond_remove(Cpub *cpub, Addr addr)
+{
+	DebugPoints	*dp = cpub->debug;
+	int		i, j;
+
+	if( dp == NULL )
+		return;
+	for( i = j = 0 ; i < dp->ncond ; i++ )
+		if( dp->cond[i].addr != addr )
+			dp->cond[j++] = dp->cond[i];
+	dp->ncond = j;
+	BrkClear(dp->condmap,addr);
+}
@@ -0,0 +1,131 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	disasm.c
+ *	Descrioption:	disassembler of the Educational CPU instruction set
+ */
+
+#include	<stdio.h>
+#include	<string.h>
+#include	"cpuboard.h"
+#include	"disasm.h"
+
+static const char	*op_names[INST_UNKNOWN] = {
+	"NOP", "HLT", "OUT", "IN", "RCF", "SCF", "LD", "ST", "ADD", "ADC",
+	"SUB", "SBC", "CMP", "AND", "OR", "EOR", NULL, NULL, NULL, "JAL",
+	"JR"
+};
+static const char	*shift_names[2][4] = {
+	{ "SRA", "SLA", "SRL", "SLL" },		/* Ssm */
+	{ "RRA", "RLA", "RRL", "RLL" }		/* Rsm */
+};
+static const char	*cond_names[BRANCH_COND_NONE] = {
+	"BA", "BVF", "BNZ", "BZ", "BZP", "BN", "BP", "BZN", "BNI", "BNO",
+	"BNC", "BC", "BGE", "BLT", "BGT", "BLE"
+};
+static const char	*reg_names[2] = { "ACC", "IX" };
+
+
+/*=============================================================================
+ *   Render an Instruction
+ *===========================================================================*/
+int
+disasm_inst(Uword w, Uword d, char *buf, size_t len)
+{
+	const InstructionInfo	*e = &decode_table[w];
+	const char		*a = reg_names[e->a_field & 1];
+
+	switch( e->type ) {
+	   case INST_LD: case INST_ST:
+	   case INST_ADD: case INST_ADC: case INST_SUB:
+	   case INST_SBC: case INST_CMP: case INST_AND:
+	   case INST_OR: case INST_EOR:
+		if( e->type == INST_ST && e->addr_mode_b <= ADDR_MODE_IMMEDIATE )
+			break;			/* decoded, but has no syntax */
+		switch( e->addr_mode_b ) {
+		   case ADDR_MODE_REG_ACC:
+		   case ADDR_MODE_REG_IX:
+			snprintf(buf,len,"%s\t%s,%s",op_names[e->type],a,
+				reg_names[e->addr_mode_b == ADDR_MODE_REG_IX]);
+			return e->word_length;
+		   case ADDR_MODE_IMMEDIATE:
+			snprintf(buf,len,"%s\t%s,0x%02x",op_names[e->type],a,d);
+			return e->word_length;
+		   case ADDR_MODE_ABS_PROG:
+			snprintf(buf,len,"%s\t%s,[0x%02x]",op_names[e->type],a,d);
+			return e->word_length;
+		   case ADDR_MODE_ABS_DATA:
+			snprintf(buf,len,"%s\t%s,(0x%02x)",op_names[e->type],a,d);
+			return e->word_length;
+		   case ADDR_MODE_IX_PROG:
+			snprintf(buf,len,"%s\t%s,[IX+0x%02x]",op_names[e->type],
+				a,d);
+			return e->word_length;
+		   case ADDR_MODE_IX_DATA:
+			snprintf(buf,len,"%s\t%s,(IX+0x%02x)",op_names[e->type],
+				a,d);
+			return e->word_length;
+		   default:
+			break;			/* no operand B: not an instruction */
+		}
+		break;
+	   case INST_Ssm: case INST_Rsm:
+		snprintf(buf,len,"%s\tACC",
+			shift_names[e->type == INST_Rsm][e->shift_mode & 3]);
+		return e->word_length;
+	   case INST_Bbc:
+		snprintf(buf,len,"%s\t0x%02x",cond_names[e->branch_cond],d);
+		return e->word_length;
+	   case INST_JAL:
+		snprintf(buf,len,"JAL\t0x%02x",d);
+		return e->word_length;
+	   case INST_UNKNOWN:
+		break;
+	   default:
+		snprintf(buf,len,"%s",op_names[e->type]);
+		return e->word_length;
+	}
+	if( e->word_length == 2 && e->type != INST_UNKNOWN ) {
+		snprintf(buf,len,".byte\t0x%02x,0x%02x",w,d);
+		return 2;
+	}
+	snprintf(buf,len,".byte\t0x%02x",w);
+	return 1;
+}
+
+
+int
+disasm(const Uword *mem, Addr pc, char *buf, size_t len)
+{
+	return disasm_inst(mem[pc & 0xff],mem[(pc + 1) & 0xff],buf,len);
+}
+
+
+/*=============================================================================
+ *   Cache of the Program Area
+ *===========================================================================*/
+typedef struct disasmline {
+	Uword	inst[2];		/* the words it was rendered from */
+	Uword	length;			/* 0: empty */
+	char	text[DISASM_TEXT];
+} DisasmLine;
+
+static DisasmLine	disasm_cache[IMEMORY_SIZE];
+
+const char *
+disasm_line(const Uword *mem, Addr pc, int *length)
+{
+	DisasmLine	*l = &disasm_cache[pc & 0xff];
+	Uword		w0 = mem[pc & 0xff], w1 = mem[(pc + 1) & 0xff];
+
+	if( l->length == 0 || l->inst[0] != w0
+	 || (l->length == 2 && l->inst[1] != w1) ) {
+		l->length = (Uword)disasm(mem,pc,l->text,sizeof(l->text));
+		l->inst[0] = w0;
+		l->inst[1] = w1;
+	}
+	if( length != NULL )
+		*length = l->length;
+	return l->text;
+}
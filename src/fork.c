@@ -0,0 +1,194 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	fork.c
+ *	Descrioption:	checkpoints of a board and copy-on-write children
+ */
+
+#include	<stdlib.h>
+#include	<string.h>
+#include	"cpuboard.h"
+#include	"fork.h"
+
+
+/*=============================================================================
+ *   Checkpoints
+ *===========================================================================*/
+/*
+ *   Checkpoint a board (the board goes on as it is)
+ */
+Checkpoint *
+fork_checkpoint(Cpub *cpub)
+{
+	Checkpoint	*cp;
+
+	if( (cp = malloc(sizeof(Checkpoint))) == NULL )
+		return NULL;
+	FlagSync(cpub);
+	cp->board = *cpub;
+	memset(&cp->input,0,sizeof(cp->input));
+	if( cpub->ibuf != NULL ) {
+		cp->input.flag = cpub->ibuf->flag;
+		cp->input.buf = cpub->ibuf->buf;
+	}
+	cp->board.ibuf = NULL;
+	cp->board.obuf.dev = NULL;
+	cp->board.trace = NULL;
+	cp->board.debug = NULL;
+	cp->board.undo = NULL;
+	cp->board.prof = NULL;
+	cp->board.timing = NULL;
+	cp->board.blocks = NULL;
+	return cp;
+}
+
+
+/* the children must have been freed */
+void
+fork_checkpoint_free(Checkpoint *cp)
+{
+	free(cp);
+}
+
+
+/*=============================================================================
+ *   Children
+ *===========================================================================*/
+/*
+ *   A child at the checkpoint
+ */
+Fork *
+fork_new(const Checkpoint *cp)
+{
+	Fork	*f;
+
+	if( (f = calloc(1,sizeof(Fork))) == NULL )
+		return NULL;
+	f->cp = cp;
+	f->pc = cp->board.pc;
+	f->acc = cp->board.acc;
+	f->ix = cp->board.ix;
+	f->cf = cp->board.cf;
+	f->vf = cp->board.vf;
+	f->nf = cp->board.nf;
+	f->zf = cp->board.zf;
+	f->input = cp->input;
+	f->obuf.flag = cp->board.obuf.flag;
+	f->obuf.buf = cp->board.obuf.buf;
+	return f;
+}
+
+
+void
+fork_free(Fork *f)
+{
+	if( f == NULL )
+		return;
+	free(f->lines);
+	free(f);
+}
+
+
+/* lines of its own */
+int
+fork_lines(const Fork *f)
+{
+	unsigned long	d;
+	int		n;
+
+	for( n = 0, d = f->dirty ; d != 0 ; d &= d - 1 )
+		n++;
+	return n;
+}
+
+
+/*
+ *   Put a child on a working board (its translations, trace, break-points
+ *   and I/O devices stay)
+ */
+void
+fork_enter(Fork *f, Cpub *cpub)
+{
+	const Uword	*line, *own = f->lines;
+	int		i, k, addr;
+
+	cpub->pc = f->pc;
+	cpub->acc = f->acc;
+	cpub->ix = f->ix;
+	cpub->cf = f->cf;
+	cpub->vf = f->vf;
+	cpub->nf = f->nf;
+	cpub->zf = f->zf;
+	cpub->flag_op = FLAGS_VALID;
+	if( cpub->ibuf != NULL ) {
+		cpub->ibuf->flag = f->input.flag;
+		cpub->ibuf->buf = f->input.buf;
+	}
+	cpub->obuf.flag = f->obuf.flag;
+	cpub->obuf.buf = f->obuf.buf;
+
+	for( i = 0 ; i < FORK_LINES ; i++ ) {
+		addr = i * FORK_LINE;
+		if( f->dirty & (1UL << i) ) {
+			line = own;
+			own += FORK_LINE;
+		} else
+			line = &f->cp->board.mem[addr];
+		if( !memcmp(&cpub->mem[addr],line,FORK_LINE) )
+			continue;
+		for( k = 0 ; addr + k < IMEMORY_SIZE && k < FORK_LINE ; k++ )
+			if( cpub->mem[addr + k] != line[k] )
+				CodeWrite(cpub,addr + k);
+		memcpy(&cpub->mem[addr],line,FORK_LINE);
+	}
+}
+
+
+/*
+ *   Take a child back from the working board: the lines that differ from
+ *   the checkpoint become its own.  -1 if out of memory (the child stays
+ *   as it was).
+ */
+int
+fork_leave(Fork *f, Cpub *cpub)
+{
+	const Uword	*base = f->cp->board.mem;
+	Uword		*lines;
+	unsigned long	dirty = 0;
+	int		i, n = 0;
+
+	for( i = 0 ; i < FORK_LINES ; i++ )
+		if( memcmp(&cpub->mem[i * FORK_LINE],&base[i * FORK_LINE],
+							FORK_LINE) ) {
+			dirty |= 1UL << i;
+			n++;
+		}
+	if( n == 0 ) {
+		free(f->lines);
+		lines = NULL;
+	} else if( (lines = realloc(f->lines,n * FORK_LINE)) == NULL )
+		return -1;
+	for( i = 0, n = 0 ; i < FORK_LINES ; i++ )
+		if( dirty & (1UL << i) )
+			memcpy(&lines[FORK_LINE * n++],&cpub->mem[i * FORK_LINE],
+								FORK_LINE);
+	f->lines = lines;
+	f->dirty = dirty;
+
+	FlagSync(cpub);
+	f->pc = cpub->pc;
+	f->acc = cpub->acc;
+	f->ix = cpub->ix;
+	f->cf = cpub->cf;
+	f->vf = cpub->vf;
+	f->nf = cpub->nf;
+	f->zf = cpub->zf;
+	if( cpub->ibuf != NULL ) {
+		f->input.flag = cpub->ibuf->flag;
+		f->input.buf = cpub->ibuf->buf;
+	}
+	f->obuf.flag = cpub->obuf.flag;
+	f->obuf.buf = cpub->obuf.buf;
+	return 0;
+}
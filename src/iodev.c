@@ -0,0 +1,236 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	iodev.c
+ *	Descrioption:	streaming files through the I/O ports of a board
+ */
+
+#define	_POSIX_C_SOURCE	200809L	/* fileno() */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	"cpuboard.h"
+#include	"iodev.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include	<sys/types.h>
+#include	<sys/stat.h>
+#include	<sys/mman.h>
+#define	IODEV_MMAP
+#endif
+
+
+/*=============================================================================
+ *   Opening and Closing
+ *
+ *   iodev_open(file, output, map) opens file for an input or an output
+ *   port ("-": stdout; stdin carries the commands); with map, an input
+ *   file is mapped whole if it can be, and read in blocks otherwise.
+ *===========================================================================*/
+static int
+iodev_map(IODev *dev)
+{
+#ifdef	IODEV_MMAP
+	struct stat	st;
+	void		*p;
+
+	if( fstat(fileno(dev->fp),&st) != 0 || !S_ISREG(st.st_mode)
+	 || st.st_size <= 0 || (unsigned long long)st.st_size > (size_t)-1 )
+		return -1;
+	p = mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_PRIVATE,
+						fileno(dev->fp),0);
+	if( p == MAP_FAILED )
+		return -1;
+	dev->buf = p;
+	dev->len = dev->size = (size_t)st.st_size;
+	dev->mapped = 1;
+	return 0;
+#else
+	(void)dev;
+	return -1;
+#endif
+}
+
+IODev *
+iodev_open(const char *file, int output, int map)
+{
+	IODev	*dev;
+
+	if( (dev = calloc(1,sizeof(IODev))) == NULL )
+		return NULL;
+	dev->output = output;
+	snprintf(dev->name,sizeof(dev->name),"%s",file);
+	if( output && !strcmp(file,"-") )
+		dev->fp = stdout;
+	else if( (dev->fp = fopen(file,output ? "wb" : "rb")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		free(dev);
+		return NULL;
+	}
+
+	if( output || !map || iodev_map(dev) != 0 ) {
+		dev->size = IODEV_BUFSIZE;
+		if( (dev->buf = malloc(dev->size)) == NULL ) {
+			iodev_close(dev);
+			return NULL;
+		}
+	}
+	return dev;
+}
+
+
+void
+iodev_close(IODev *dev)
+{
+	if( dev == NULL )
+		return;
+	if( dev->output )
+		iodev_flush(dev);
+#ifdef	IODEV_MMAP
+	if( dev->mapped )
+		munmap(dev->buf,dev->size);
+	else
+#endif
+		free(dev->buf);
+	if( dev->fp != stdout )
+		fclose(dev->fp);
+	free(dev);
+}
+
+
+/*
+ *   Write out the buffered words of an output device (-1: write error)
+ */
+int
+iodev_flush(IODev *dev)
+{
+	if( dev == NULL || !dev->output )
+		return 0;
+	if( dev->pos > 0 && !dev->error
+	 && fwrite(dev->buf,1,dev->pos,dev->fp) != dev->pos ) {
+		fprintf(stderr,"Unable to write %s\n",dev->name);
+		dev->error = 1;
+	}
+	dev->pos = 0;
+	if( !dev->error && fflush(dev->fp) != 0 )
+		dev->error = 1;
+	return dev->error ? -1 : 0;
+}
+
+
+/*
+ *   Have at least n input bytes in the buffer, unless the file ends first
+ */
+void
+iodev_reserve(IODev *dev, size_t n)
+{
+	if( dev == NULL || dev->output || dev->mapped
+	 || dev->len - dev->pos >= n )
+		return;
+	memmove(dev->buf,dev->buf + dev->pos,dev->len - dev->pos);
+	dev->len -= dev->pos;
+	dev->pos = 0;
+	dev->len += fread(dev->buf + dev->len,1,dev->size - dev->len,dev->fp);
+}
+
+
+/*=============================================================================
+ *   Ports
+ *===========================================================================*/
+/* put the next input byte into the port, or lower its flag at the end */
+static void
+iodev_next(IOBuf *io)
+{
+	IODev	*dev = io->dev;
+
+	if( dev->pos == dev->len ) {
+		dev->pos = dev->len = 0;
+		if( !dev->mapped )
+			dev->len = fread(dev->buf,1,dev->size,dev->fp);
+		if( dev->len == 0 ) {
+			dev->eof = 1;
+			IOBufStore(io->flag,0);
+			return;
+		}
+	}
+	IOBufStore(io->buf,dev->buf[dev->pos++]);
+	IOBufStore(io->flag,1);
+}
+
+
+/*
+ *   Attach a device to a port (closing the one there); an input port is
+ *   filled at once
+ */
+void
+iodev_attach(IOBuf *io, IODev *dev)
+{
+	iodev_detach(io);
+	io->dev = dev;
+	if( dev->output )
+		IOBufStore(io->flag,0);
+	else
+		iodev_next(io);
+}
+
+
+/*
+ *   Close the device of a port; a byte already in an input port stays
+ */
+void
+iodev_detach(IOBuf *io)
+{
+	iodev_close(io->dev);
+	io->dev = NULL;
+}
+
+
+/*
+ *   IN from a port with a device; an output device is never ready and
+ *   keeps its position, so IN just reads the last word OUT
+ */
+Uword
+iodev_take(IOBuf *io)
+{
+	Uword	data;
+
+	data = io->buf;
+	if( io->dev->output )
+		return data;
+	if( io->flag )
+		io->dev->bytes++;
+	iodev_next(io);
+	return data;
+}
+
+
+/* OUT to a port with a device */
+void
+iodev_put(IOBuf *io, Uword data)
+{
+	IODev	*dev = io->dev;
+
+	io->buf = data;
+	dev->buf[dev->pos++] = data;
+	dev->bytes++;
+	if( dev->pos == dev->size )
+		iodev_flush(dev);
+}
+
+
+/*
+ *   The board waits at BNI for an input device that has reached the end
+ *   of its file
+ */
+int
+iodev_starved(Cpub *cpub)
+{
+	const InstructionInfo	*info = &decode_table[cpub->mem[cpub->pc]];
+
+	return cpub->ibuf != NULL && cpub->ibuf->dev != NULL
+		&& cpub->ibuf->dev->eof && !iobuf_ready(cpub->ibuf)
+		&& info->type == INST_Bbc
+		&& info->branch_cond == BRANCH_COND_NI;
+}
@@ -0,0 +1,236 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	loader.c
+ *	Descrioption:	loading programs into the main memory
+ */
+
+#include	<stdio.h>
+#include	<string.h>
+#include	"cpuboard.h"
+#include	"loader.h"
+
+
+/*=============================================================================
+ *   Images
+ *===========================================================================*/
+static unsigned long
+img_get(const unsigned char *p)
+{
+	return p[0] | ((unsigned long)p[1] << 8);
+}
+
+static void
+img_put(unsigned char *p, unsigned long v, int n)
+{
+	while( n-- > 0 ) {
+		*p++ = (unsigned char)v;
+		v >>= 8;
+	}
+}
+
+static unsigned long
+img_checksum(const unsigned char *buf, size_t size)
+{
+	unsigned long	h = 2166136261UL;
+	size_t		i;
+
+	for( i = 8 ; i < size ; i++ )
+		if( i < 16 || i >= IMG_HEADER )
+			h = ((h ^ buf[i]) * 16777619UL) & 0xffffffffUL;
+	return h;
+}
+
+/* load an image read whole into buf; -1 if it is malformed */
+static int
+load_image(Cpub *cpub, const unsigned char *buf, size_t size, Uword *map)
+{
+	const unsigned char	*seg, *words;
+	unsigned long		addr, len, i;
+	int			n, k;
+
+	n = buf[8];
+	words = buf + IMG_HEADER + n * IMG_SEGMENT;
+	if( size < IMG_HEADER + (size_t)n * IMG_SEGMENT
+	 || img_checksum(buf,size) != (img_get(buf + 16)
+					| (img_get(buf + 18) << 16)) )
+		return -1;
+	for( k = 0, len = 0 ; k < n ; k++ ) {
+		seg = buf + IMG_HEADER + k * IMG_SEGMENT;
+		if( img_get(seg) + img_get(seg + 2) > MEMORY_SIZE )
+			return -1;
+		len += img_get(seg + 2);
+	}
+	if( words + len != buf + size )
+		return -1;
+
+	for( k = 0 ; k < n ; k++ ) {
+		seg = buf + IMG_HEADER + k * IMG_SEGMENT;
+		addr = img_get(seg);
+		len = img_get(seg + 2);
+		memcpy(cpub->mem + addr,words,len);
+		for( i = addr ; i < addr + len ; i++ ) {
+			CodeWrite(cpub,i);
+			if( map != NULL )
+				BrkSet(map,i);
+		}
+		words += len;
+	}
+	cpub->pc = buf[9];
+	cpub->acc = buf[10];
+	cpub->ix = buf[11];
+	cpub->cf = (buf[12] >> 3) & 1;
+	cpub->vf = (buf[12] >> 2) & 1;
+	cpub->nf = (buf[12] >> 1) & 1;
+	cpub->zf = buf[12] & 1;
+	cpub->flag_op = FLAGS_VALID;
+	return 0;
+}
+
+
+/*
+ *   Write the words marked in map (1 bit/address) and the registers of a
+ *   board as an image; 0 on success
+ */
+int
+write_mem_image(const Cpub *cpub, const Uword *map, const char *file)
+{
+	unsigned char	buf[IMG_MAX], *seg, *words;
+	int		addr, start, n = 0;
+	size_t		len = 0;
+	FILE		*fp;
+	int		result = -1;
+
+	/* segments: runs of marked words */
+	for( addr = 0 ; addr < MEMORY_SIZE ; addr++ )
+		if( BrkTest(map,addr) && (addr == 0 || !BrkTest(map,addr - 1)) )
+			n++;
+	if( n > 255 )
+		return -1;
+	memset(buf,0,IMG_HEADER);
+	memcpy(buf,IMG_MAGIC,8);
+	buf[8] = n;
+	buf[9] = cpub->pc;
+	buf[10] = cpub->acc;
+	buf[11] = cpub->ix;
+	buf[12] = (cpub->cf << 3) | (cpub->vf << 2) | (cpub->nf << 1) | cpub->zf;
+	seg = buf + IMG_HEADER;
+	words = seg + n * IMG_SEGMENT;
+	for( addr = 0 ; addr < MEMORY_SIZE ; ) {
+		if( !BrkTest(map,addr) ) {
+			addr++;
+			continue;
+		}
+		for( start = addr ; addr < MEMORY_SIZE && BrkTest(map,addr) ; )
+			*words++ = cpub->mem[addr++];
+		img_put(seg,start,2);
+		img_put(seg + 2,addr - start,2);
+		seg += IMG_SEGMENT;
+	}
+	len = words - buf;
+	img_put(buf + 16,img_checksum(buf,len),4);
+
+	if( (fp = fopen(file,"wb")) == NULL )
+		return -1;
+	if( fwrite(buf,1,len,fp) == len )
+		result = 0;
+	if( fclose(fp) != 0 )
+		result = -1;
+	return result;
+}
+
+
+/*=============================================================================
+ *   Read a Program File (text or image)
+ *
+ *   Returns 0 on success and -1 if the file cannot be opened or is
+ *   malformed (the words of a text file before the error stay loaded, a
+ *   bad image loads nothing).
+ *===========================================================================*/
+int
+read_mem_file(Cpub *cpub, const char *file)
+{
+	return read_mem_map(cpub,file,NULL);
+}
+
+
+/*
+ *   The same, marking the words loaded in map (1 bit/address)
+ *   unless it is NULL
+ */
+int
+read_mem_map(Cpub *cpub, const char *file, Uword *map)
+{
+#define	TOKENSIZE	160
+	FILE		*fp;
+	unsigned char	buf[IMG_MAX + 1];
+	unsigned int	addr, word;
+	Addr		area;
+	char		token[TOKENSIZE];
+	size_t		size;
+	int		result = -1;
+
+	if( (fp = fopen(file,"r")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		return -1;
+	}
+
+	size = fread(buf,1,sizeof(buf),fp);
+	if( size >= 8 && !memcmp(buf,IMG_MAGIC,8) ) {
+		if( size > IMG_MAX || load_image(cpub,buf,size,map) != 0 )
+			fprintf(stderr,"Broken image: %s\n",file);
+		else
+			result = 0;
+		goto error;
+	}
+	rewind(fp);
+
+	addr = 0;	/* default initial address */
+	while( fscanf(fp,"%159s",token) == 1 ) {
+		if( token[0] == '.' ) {		/* directive */
+			/*
+			 *   Check the directive type
+			 */
+			if( !strcmp(token+1,"text") ) {
+				area = 0x000;
+			} else
+			if( !strcmp(token+1,"data") ) {
+				area = 0x100;
+			} else {
+				fprintf(stderr,"Unknown directive: %s\n",token);
+				goto error;
+			}
+
+			/*
+			 *   Change the current address
+			 */
+			if( fscanf(fp,"%x",&addr) != 1 || addr > 0xff ) {
+				fprintf(stderr,"Invalid address: %s %x\n",
+								token,addr);
+				goto error;
+			}
+			addr |= area;
+		} else {			/* instruction word or data */
+			if( sscanf(token,"%x",&word) != 1 || word > 0xff ) {
+				fprintf(stderr,"Invalid value at addr=0x%03x: "
+							"%s\n",addr,token);
+				goto error;
+			}
+			if( addr >= MEMORY_SIZE ) {
+				fprintf(stderr,"Program too large: %s\n",file);
+				goto error;
+			}
+			cpub->mem[addr] = word;
+			CodeWrite(cpub,addr);
+			if( map != NULL )
+				BrkSet(map,addr);
+			addr++;
+		}
+	}
+	result = 0;
+
+     error:
+	fclose(fp);
+	return result;
+}
@@ -6,22 +6,54 @@
  *	Descrioption:	main profram (command interpreter)
  */
 
+#define	_POSIX_C_SOURCE	200809L	/* clock_gettime() */
+
 #include	<stdio.h>
 #include	<stdlib.h>
 #include	<string.h>
+#include	<signal.h>
+#include	<time.h>
 #include	"cpuboard.h"
+#include	"trace.h"
+#include	"debug.h"
+#include	"loader.h"
+#include	"iodev.h"
+#include	"network.h"
+#include	"snapshot.h"
+#include	"fork.h"
+#include	"undo.h"
+#include	"profile.h"
+#include	"timing.h"
+#include	"asm.h"
+#include	"disasm.h"
 
 
 void	help(void);
 int	init_cpub(void);
 void	cont(Cpub *, char *);
+void	back(Cpub *, char *);
+void	reverse_cont(Cpub *);
+void	undo_command(Cpub *, int, char *);
+void	set_budget(char *);
+void	net_command(int *, int, char *, char *);
+void	engine_command(int, char *);
+void	io_command(int, int, char *, char *, char *);
+void	snap_command(int *, int, char *, char *);
+void	ckpt_command(int, int);
+void	fork_command(int *, int, char *);
 void	display_regs(Cpub *);
 void	set_reg(Cpub *, char *, char *);
 void	display_mem(Cpub *, char *);
 void	display_mem_line(Cpub *, Addr);
 void	display_mem_all(Cpub *);
+void	disasm_mem(Cpub *, int, char *, char *);
 void	set_mem(Cpub *, char *, char *);
-void	read_mem_file(Cpub *, char *);
+void	trace_command(Cpub *, int, char *, char *);
+void	prof_command(Cpub *, int, char *, char *);
+void	cycles_command(Cpub *, int, char *, char *);
+void	debug_command(Cpub *, int, char *, char *, char *);
+void	list_debug_points(Cpub *);
+void	report_watch(Cpub *);
 void	cmd_syntax_error(void);
 void	unknown_command(void);
 
@@ -29,7 +61,7 @@ void	unknown_command(void);
 /*=============================================================================
  *   CPU Board States
  *===========================================================================*/
-Cpub	cpuboard[2];	/* CPU board state */
+Network	*net;		/* CPU board states and their connections */
 
 
 /*=============================================================================
@@ -42,17 +74,68 @@ help(void)
 					"(one step execution)\n");
 	fprintf(stderr,"   c [addr]\t--- continue(start) execution "
 					"[to address(hex)]\n");
+	fprintf(stderr,"   b [count]\t--- step back count instructions "
+					"(default 1)\n");
+	fprintf(stderr,"   rc\t\t--- continue backwards to a break-point "
+					"or watch-point\n");
+	fprintf(stderr,"   undo [MB|off]\t--- show or set the undo log "
+					"of b and rc\n");
+	fprintf(stderr,"   l [count]\t--- show or set the instruction budget "
+					"of c (0: unlimited)\n");
+	fprintf(stderr,"   engine [name]\t--- show or select the execution "
+					"engine of c\n"
+					"\t\t\t(block,threaded,step,jit,jit-check)\n");
 	fprintf(stderr,"   d\t\t--- display the contents of registers\n");
 	fprintf(stderr,"   s reg data\t--- set data(hex) to the register\n"
 					"\t\t\treg: pc,acc,ix,cf,vf,nf,zf,"
 					"ibuf,if,obuf,of\n");
 	fprintf(stderr,"   m [addr]\t--- dump memory or display data "
 					"at memory address(hex)\n");
+	fprintf(stderr,"   u [addr [count]]\t--- disassemble count(hex) "
+					"instructions from addr\n");
 	fprintf(stderr,"   w addr data\t--- write data(hex) "
 					"at memory address(hex)\n");
 	fprintf(stderr,"   r file\t--- load a program into the main memory "
 					"from the file\n");
-	fprintf(stderr,"   t\t\t--- toggle current computer(context)\n");
+	fprintf(stderr,"   a file\t--- assemble a program into the main memory "
+					"from the file\n");
+	fprintf(stderr,"   t [id]\t--- toggle current computer(context) "
+					"[to board id]\n");
+	fprintf(stderr,"   net [load file|run]\t--- show the boards, load "
+					"a network or run all boards\n");
+	fprintf(stderr,"   save file\t--- save the boards and their "
+					"connections to the file\n");
+	fprintf(stderr,"   load file\t--- restore the boards saved "
+					"with save\n");
+	fprintf(stderr,"   ckpt\t\t--- checkpoint the board; it goes on "
+					"as fork 0\n");
+	fprintf(stderr,"   fork [id]\t--- list the forks of the checkpoint "
+					"or switch to fork id\n");
+	fprintf(stderr,"   io [in file [mmap]|out file|close]\t--- show the "
+					"I/O devices, stream a file\n"
+					"\t\t\tinto ibuf or obuf into a file "
+					"('-': stdout)\n");
+	fprintf(stderr,"   trace [level]\t--- show or set the trace level "
+					"(off,inst,phase)\n");
+	fprintf(stderr,"   trace ring [n|off]\t--- record the last n "
+					"instructions in a binary ring\n");
+	fprintf(stderr,"   trace dump [file]\t--- print the ring "
+					"[or save it to the file]\n");
+	fprintf(stderr,"   prof [on|off|clear|csv file]\t--- profile the "
+					"board: report, start, stop, reset\n"
+			"\t\t\tor export the counts as CSV\n");
+	fprintf(stderr,"   cycles [on [Hz]|off|clear]\t--- count the clock "
+					"cycles of the board and\n"
+			"\t\t\testimate its runtime at Hz (default %lu)\n",
+								TIMING_HZ);
+	fprintf(stderr,"   bp [addr [cond]]\t--- list or set a break-point "
+					"[stop only if cond]\n"
+					"\t\t\tcond: reg==data (!=,<,>,<=,>=), "
+					"reg: acc,ix,cf,vf,nf,zf\n");
+	fprintf(stderr,"   bd addr|all\t--- delete break-points\n");
+	fprintf(stderr,"   wp [addr]\t--- list or set a watch-point on "
+					"ST to memory address(hex)\n");
+	fprintf(stderr,"   wd addr|all\t--- delete watch-points\n");
 	fprintf(stderr,"   h\t\t--- help (this menu)\n");
 	fprintf(stderr,"   ?\t\t--- help (this menu)\n");
 	fprintf(stderr,"   q\t\t--- quit\n");
@@ -65,8 +148,11 @@ help(void)
 int
 init_cpub(void)
 {
-	cpuboard[0].ibuf = &(cpuboard[1].obuf);
-	cpuboard[1].ibuf = &(cpuboard[0].obuf);
+	init_decode_table();
+	if( (net = net_new(2)) == NULL ) {	/* two boards in a ring */
+		fprintf(stderr,"Unable to allocate the CPU boards\n");
+		exit(1);
+	}
 	return 0;
 }
 
@@ -82,13 +168,13 @@ main()
 	char	cmd[CLSIZE], arg1[CLSIZE], arg2[CLSIZE], dummy[CLSIZE];
 	Cpub	*cpub;			/* current CPU board state */
 	int	cpub_id;		/* current CPU board ID */
-	int	n;
+	int	n, id;
 
 	/*
 	 *   Initialize the CPU board state
 	 */
 	cpub_id = init_cpub();
-	cpub = &(cpuboard[cpub_id]);
+	cpub = &(net->board[cpub_id]);
 
 	/*
 	 *   Interpret commands
@@ -103,11 +189,72 @@ main()
 		/*
 		 *   Input a command line
 		 */
-		if( fgets(cmdline,CLSIZE,stdin) == NULL )
+		if( fgets(cmdline,CLSIZE,stdin) == NULL ) {
+			net_free(net);	/* flushes the output devices */
 			return 0; /* exiting */
+		}
 		if( (n = sscanf(cmdline,"%s%s%s%s",cmd,arg1,arg2,dummy)) <= 0 )
 			continue; /* empty input, so retry */
 
+		/*
+		 *   Interpet a long-name command
+		 */
+		if( !strcmp(cmd,"trace") ) {
+			trace_command(cpub,n,arg1,arg2);
+			continue;
+		}
+		if( !strcmp(cmd,"prof") ) {
+			prof_command(cpub,n,arg1,arg2);
+			continue;
+		}
+		if( !strcmp(cmd,"cycles") ) {
+			cycles_command(cpub,n,arg1,arg2);
+			continue;
+		}
+		if( !strcmp(cmd,"rc") ) {
+			if( n != 1 )
+				cmd_syntax_error();
+			else
+				reverse_cont(cpub);
+			continue;
+		}
+		if( !strcmp(cmd,"undo") ) {
+			undo_command(cpub,n,arg1);
+			continue;
+		}
+		if( !strcmp(cmd,"engine") ) {
+			engine_command(n,arg1);
+			continue;
+		}
+		if( !strcmp(cmd,"net") ) {
+			net_command(&cpub_id,n,arg1,arg2);
+			cpub = &(net->board[cpub_id]);
+			continue;
+		}
+		if( !strcmp(cmd,"save") || !strcmp(cmd,"load") ) {
+			snap_command(&cpub_id,n,cmd,arg1);
+			cpub = &(net->board[cpub_id]);
+			continue;
+		}
+		if( !strcmp(cmd,"ckpt") ) {
+			ckpt_command(cpub_id,n);
+			continue;
+		}
+		if( !strcmp(cmd,"fork") ) {
+			fork_command(&cpub_id,n,arg1);
+			cpub = &(net->board[cpub_id]);
+			continue;
+		}
+		if( !strcmp(cmd,"io") ) {
+			io_command(cpub_id,n,arg1,arg2,dummy);
+			continue;
+		}
+		if( !strcmp(cmd,"bp") || !strcmp(cmd,"bd")
+		 || !strcmp(cmd,"wp") || !strcmp(cmd,"wd") ) {
+			debug_command(cpub,n,cmd,arg1,arg2);
+			continue;
+		}
+
 		/*
 		 *   Interpet a command
 		 */
@@ -120,6 +267,8 @@ main()
 			if( step(cpub) == RUN_HALT ) {
 				fprintf(stderr,"Program Halted.\n");
 			}
+			if( cpub->debug != NULL && cpub->debug->hit )
+				report_watch(cpub);
 			break;
 		   case 'c':
 			switch( n ) {
@@ -128,6 +277,20 @@ main()
 			   default:	goto syntaxerr;
 			}
 			break;
+		   case 'b':
+			switch( n ) {
+			   case 1:	back(cpub,NULL); break;
+			   case 2:	back(cpub,arg1); break;
+			   default:	goto syntaxerr;
+			}
+			break;
+		   case 'l':
+			switch( n ) {
+			   case 1:	set_budget(NULL); break;
+			   case 2:	set_budget(arg1); break;
+			   default:	goto syntaxerr;
+			}
+			break;
 		   case 'd':
 			if( n != 1 ) goto syntaxerr;
 			display_regs(cpub);
@@ -143,6 +306,10 @@ main()
 			   default:	goto syntaxerr;
 			}
 			break;
+		   case 'u':
+			if( n > 3 ) goto syntaxerr;
+			disasm_mem(cpub,n,arg1,arg2);
+			break;
 		   case 'w':
 			if( n != 3 ) goto syntaxerr;
 			set_mem(cpub,arg1,arg2);
@@ -151,9 +318,28 @@ main()
 			if( n != 2 ) goto syntaxerr;
 			read_mem_file(cpub,arg1);
 			break;
+		   case 'a':
+			if( n != 2 ) goto syntaxerr;
+			asm_file(cpub,arg1);
+			break;
 		   case 't':
-			cpub_id ^= 1;
-			cpub = &(cpuboard[cpub_id]);
+			switch( n ) {
+			   case 1:
+				cpub_id = (cpub_id + 1) % net->n;
+				break;
+			   case 2:
+				if( sscanf(arg1,"%d",&id) != 1
+				 || id < 0 || id >= net->n ) {
+					fprintf(stderr,"No such board: %s\n",
+									arg1);
+					break;
+				}
+				cpub_id = id;
+				break;
+			   default:
+				goto syntaxerr;
+			}
+			cpub = &(net->board[cpub_id]);
 			break;
 		   case 'h':
 		   case '?':
@@ -162,8 +348,8 @@ main()
 		   case 'q':
 			if( n != 1 )
 				goto syntaxerr;
-			else
-				return 0; /* exiting */
+			net_free(net);
+			return 0; /* exiting */
 			break; /* never reach here */
 		   default:
 			unknown_command();
@@ -179,43 +365,541 @@ main()
 
 /*=============================================================================
  *   Command: Continue(Start) Execution
+ *
+ *   Runs until HLT, a break-point, the instruction budget or Ctrl-C, in
+ *   chunks so that an interrupt is noticed without slowing the engine.
  *===========================================================================*/
+#define	EXEC_CHUNK	(1ULL << 24)	/* instructions between ^C checks */
+
+static const struct {
+	const char	*name;
+	RunEngine	*run;
+} engines[] = {
+	{ "block",	run_block },	/* translation cache (default) */
+	{ "threaded",	run_threaded },	/* threaded code */
+	{ "step",	run_step },	/* reference, one step() at a time */
+	{ "jit",	run_jit },	/* native code for hot blocks (x86-64) */
+	{ "jit-check",	run_jit_check },/* jit, compared with step() */
+};
+#define	NENGINES	(int)(sizeof(engines)/sizeof(engines[0]))
+
+static int	engine = 0;		/* 'engine' command */
+
+unsigned long long	exec_budget = ~0ULL;	/* 'l' command; ~0: unlimited */
+static volatile sig_atomic_t	interrupted;
+
+static void
+interrupt(int sig)
+{
+	(void)sig;
+	interrupted = 1;
+}
+
+static void
+report_speed(unsigned long long total, const struct timespec *t0,
+						const struct timespec *t1)
+{
+	double	sec;
+
+	sec = (t1->tv_sec - t0->tv_sec) + (t1->tv_nsec - t0->tv_nsec) * 1e-9;
+	fprintf(stderr,"\t%llu instructions in %.6f sec",total,sec);
+	if( sec > 0 )
+		fprintf(stderr," (%.2f MIPS)",total / sec / 1e6);
+	fprintf(stderr,"\n");
+}
+
 void
 cont(Cpub *cpub, char *straddr)
 {
-#define	MAX_EXEC_COUNT	500
-	int	addr;
-	Addr	breakp;
-	int	count;
+	unsigned int		addr;
+	int			temp_break = 0, temp_uncond = 0;
+	unsigned long long	total, n, chunk, cycles = 0;
+	int			result;
+	struct timespec		t0, t1;
 
 	/*
-	 *   Check and set a break-point address
+	 *   Check and set a (temporary) break-point address
 	 */
-	if( straddr == NULL )
-		breakp = 0xffff;	/* impossible address (on purpose) */
-	else {
+	if( straddr != NULL ) {
 		sscanf(straddr,"%x",&addr);
-		if( addr < 0 || addr >= IMEMORY_SIZE ) {
+		if( addr >= IMEMORY_SIZE ) {
 			fprintf(stderr,"Invalid address: 0x%x\n",addr);
 			return;
 		}
-		breakp = addr;
+		if( !BrkTest(cpub->brkmap,addr) ) {
+			BrkSet(cpub->brkmap,addr);
+			temp_break = 1;
+		} else if( cpub->debug != NULL
+			&& BrkTest(cpub->debug->condmap,addr) ) {
+			BrkClear(cpub->debug->condmap,addr);
+			temp_uncond = 1;
+		}
 	}
+	if( cpub->debug != NULL )
+		cpub->debug->hit = 0;
 
 	/*
 	 *   Execute a program
 	 */
-	count = 1;
+	interrupted = 0;
+	signal(SIGINT,interrupt);
+	if( cpub->timing != NULL )
+		cycles = cpub->timing->cycles;
+	clock_gettime(CLOCK_MONOTONIC,&t0);
+	total = 0;
 	do {
-		if( step(cpub) == RUN_HALT ) {
-			fprintf(stderr,"Program Halted.\n");
+		chunk = exec_budget - total;
+		if( chunk > EXEC_CHUNK )
+			chunk = EXEC_CHUNK;
+		result = engines[engine].run(cpub,chunk,&n);
+		total += n;
+	} while( result == RUN_STEP && total < exec_budget && !interrupted
+						&& !iodev_starved(cpub) );
+	clock_gettime(CLOCK_MONOTONIC,&t1);
+	signal(SIGINT,SIG_DFL);
+	iodev_flush(cpub->obuf.dev);
+
+	if( temp_break )
+		BrkClear(cpub->brkmap,addr);
+	if( temp_uncond )
+		BrkSet(cpub->debug->condmap,addr);
+
+	switch( result ) {
+	   case RUN_HALT:
+		fprintf(stderr,"Program Halted.\n");
+		break;
+	   case RUN_BREAK:
+		if( cpub->debug != NULL && cpub->debug->hit )
+			report_watch(cpub);
+		else
+			fprintf(stderr,"Break at 0x%02x.\n",cpub->pc);
+		break;
+	   default:
+		if( interrupted )
+			fprintf(stderr,"Interrupted.\n");
+		else if( iodev_starved(cpub) )
+			fprintf(stderr,"End of Input.\n");
+		else
+			fprintf(stderr,"Too Many Instructions are Executed.\n");
+		break;
+	}
+
+	report_speed(total,&t0,&t1);
+	if( cpub->timing != NULL ) {
+		cycles = cpub->timing->cycles - cycles;
+		fprintf(stderr,"\t%llu cycles, %.6f sec on the board\n",
+			cycles,timing_seconds(cpub->timing,cycles));
+	}
+}
+
+
+/*=============================================================================
+ *   Command: Reverse Execution (see undo.h)
+ *
+ *	undo [MB|off]	show the undo log, or log at most MB megabytes of
+ *			the board from now on
+ *	b [count]	step back count instructions (default 1)
+ *	rc		go back to the last break-point passed or to the
+ *			ST into a watch-point
+ *===========================================================================*/
+void
+undo_command(Cpub *cpub, int n, char *arg)
+{
+	unsigned long	mb;
+
+	if( n > 2 ) {
+		cmd_syntax_error();
+		return;
+	}
+	if( n == 2 ) {
+		undo_free(cpub->undo);
+		cpub->undo = NULL;
+		if( strcmp(arg,"off") ) {
+			if( sscanf(arg,"%lu",&mb) != 1 || mb == 0 ) {
+				cmd_syntax_error();
+				return;
+			}
+			if( (cpub->undo = undo_create(mb << 20)) == NULL )
+				fprintf(stderr,"Unable to allocate an undo "
+								"log\n");
+		}
+	}
+	if( cpub->undo == NULL )
+		fprintf(stderr,"\tundo=off\n");
+	else
+		fprintf(stderr,"\tundo=%lu MB  %llu instructions in %lu "
+			"bytes\n",(unsigned long)(cpub->undo->limit >> 20),
+			cpub->undo->n,(unsigned long)cpub->undo->size);
+}
+
+static int
+no_undo_log(Cpub *cpub)
+{
+	if( cpub->undo != NULL )
+		return 0;
+	fprintf(stderr,"No undo log. Use \'undo %lu\'.\n",UNDO_DEFAULT >> 20);
+	return 1;
+}
+
+void
+back(Cpub *cpub, char *strcount)
+{
+	unsigned long long	count = 1, done;
+
+	if( no_undo_log(cpub) )
+		return;
+	if( strcount != NULL && sscanf(strcount,"%llu",&count) != 1 ) {
+		cmd_syntax_error();
+		return;
+	}
+	done = undo_seek(cpub,count);
+	if( done < count )
+		fprintf(stderr,"Start of the undo log.\n");
+	fprintf(stderr,"\t%llu instructions back\n",done);
+}
+
+void
+reverse_cont(Cpub *cpub)
+{
+	unsigned long long	done = 0;
+	int			stored;
+
+	if( no_undo_log(cpub) )
+		return;
+	for( ;; ) {
+		if( undo_back(cpub,&stored) != 0 ) {
+			fprintf(stderr,"Start of the undo log.\n");
+			break;
+		}
+		done++;
+		if( stored >= 0 && cpub->debug != NULL
+		 && BrkTest(cpub->debug->watchmap,stored) ) {
+			fprintf(stderr,"Watch-point: 0x%03x written at "
+				"PC=0x%02x.\n",stored,cpub->pc);
+			break;
+		}
+		if( BrkTest(cpub->brkmap,cpub->pc) && debug_break(cpub) ) {
+			fprintf(stderr,"Break at 0x%02x.\n",cpub->pc);
+			break;
+		}
+	}
+	fprintf(stderr,"\t%llu instructions back\n",done);
+}
+
+
+/*=============================================================================
+ *   Command: Show or Set the Instruction Budget of 'c'
+ *===========================================================================*/
+void
+set_budget(char *strval)
+{
+	unsigned long long	value;
+
+	if( strval != NULL ) {
+		if( sscanf(strval,"%llu",&value) != 1 ) {
+			cmd_syntax_error();
 			return;
 		}
-		if( count++ > MAX_EXEC_COUNT ) {
-			fprintf(stderr,"Too Many Instructions are Executed.\n");
+		exec_budget = (value == 0) ? ~0ULL : value;
+	}
+	if( exec_budget == ~0ULL )
+		fprintf(stderr,"\tbudget=unlimited\n");
+	else
+		fprintf(stderr,"\tbudget=%llu instructions\n",exec_budget);
+}
+
+
+/*=============================================================================
+ *   Command: Networks of Boards
+ *
+ *	net		show the boards and their connections
+ *	net load file	replace the boards with a network (see network.c)
+ *	net run		run all boards with the engine and budget of 'c'
+ *===========================================================================*/
+void
+net_command(int *id, int n, char *arg1, char *arg2)
+{
+	Network			*new;
+	unsigned long long	total, k, chunk;
+	int			i, result, threads;
+	struct timespec		t0, t1;
+
+	if( n == 3 && !strcmp(arg1,"load") ) {
+		if( (new = net_read_config(arg2)) == NULL )
+			return;
+		net_free(net);
+		net = new;
+		*id = 0;
+	} else if( n == 2 && !strcmp(arg1,"run") ) {
+		threads = net->threads;
+		if( engines[engine].run == run_jit_check )
+			net->threads = 0;	/* one shadow board only */
+		memset(net->halted,0,net->n);
+		interrupted = 0;
+		signal(SIGINT,interrupt);
+		clock_gettime(CLOCK_MONOTONIC,&t0);
+		total = 0;
+		do {
+			chunk = exec_budget - total;
+			if( chunk > EXEC_CHUNK )
+				chunk = EXEC_CHUNK;
+			result = run_network(net,engines[engine].run,chunk,&k);
+			total += k;
+		} while( result == RUN_STEP && total < exec_budget
+							&& !interrupted );
+		clock_gettime(CLOCK_MONOTONIC,&t1);
+		signal(SIGINT,SIG_DFL);
+		net->threads = threads;
+		for( i = 0 ; i < net->n ; i++ )
+			iodev_flush(net->board[i].obuf.dev);
+
+		switch( result ) {
+		   case RUN_HALT:
+			fprintf(stderr,"All Programs Halted.\n");
+			break;
+		   case RUN_BREAK:
+			*id = net->stopped;
+			if( net->board[*id].debug != NULL
+			 && net->board[*id].debug->hit ) {
+				fprintf(stderr,"CPU%d: ",*id);
+				report_watch(&net->board[*id]);
+			} else
+				fprintf(stderr,"CPU%d: Break at 0x%02x.\n",*id,
+							net->board[*id].pc);
+			break;
+		   default:
+			if( interrupted )
+				fprintf(stderr,"Interrupted.\n");
+			else
+				fprintf(stderr,"Too Many Instructions are "
+							"Executed.\n");
+			break;
+		}
+		report_speed(total,&t0,&t1);
+		return;
+	} else if( n != 1 ) {
+		cmd_syntax_error();
+		return;
+	}
+
+	fprintf(stderr,"\ttopology=%s  quantum=%llu  threads=%d\n",
+			net->topology,net->quantum,
+			net->threads > 1 ? net->threads : 1);
+	for( i = 0 ; i < net->n ; i++ ) {
+		fprintf(stderr,"\tCPU%d  PC=0x%02x  input=",i,net->board[i].pc);
+		if( net->src[i] == NET_OPERATOR )
+			fprintf(stderr,"operator\n");
+		else
+			fprintf(stderr,"CPU%d\n",net->src[i]);
+	}
+}
+
+
+/*=============================================================================
+ *   Command: Snapshots of the Boards (see snapshot.h)
+ *
+ *	save file	registers, ports, memory and connections of all boards
+ *	load file	restore them (the current board stays if it exists)
+ *===========================================================================*/
+void
+snap_command(int *id, int n, char *cmd, char *file)
+{
+	int	i;
+
+	if( n != 2 ) {
+		cmd_syntax_error();
+		return;
+	}
+	if( !strcmp(cmd,"save") )
+		snap_save(net,file);
+	else if( snap_load(&net,file) == 0 ) {
+		for( i = 0 ; i < net->n ; i++ )
+			undo_clear(net->board[i].undo);
+		if( *id >= net->n )
+			*id = 0;
+	}
+}
+
+
+/*=============================================================================
+ *   Command: Checkpoint and Forks of a Board (see fork.h)
+ *
+ *	ckpt		checkpoint the current board, dropping the forks of the
+ *			last checkpoint; the board goes on as fork 0
+ *	fork		list the forks
+ *	fork id		keep the state of the board in its fork and put fork
+ *			id there (a new one starts at the checkpoint)
+ *===========================================================================*/
+#define	FORK_MAX	256
+
+static Checkpoint	*ckpt;
+static int		ckpt_board;		/* board of the forks */
+static Fork		*forks[FORK_MAX];
+static int		fork_on;		/* fork on the board */
+
+static void
+drop_forks(void)
+{
+	int	i;
+
+	for( i = 0 ; i < FORK_MAX ; i++ ) {
+		fork_free(forks[i]);
+		forks[i] = NULL;
+	}
+	fork_checkpoint_free(ckpt);
+	ckpt = NULL;
+}
+
+void
+ckpt_command(int id, int n)
+{
+	if( n != 1 ) {
+		cmd_syntax_error();
+		return;
+	}
+	drop_forks();
+	if( (ckpt = fork_checkpoint(&net->board[id])) == NULL
+	 || (forks[0] = fork_new(ckpt)) == NULL ) {
+		fprintf(stderr,"Unable to allocate a checkpoint\n");
+		drop_forks();
+		return;
+	}
+	ckpt_board = id;
+	fork_on = 0;
+}
+
+void
+fork_command(int *id, int n, char *strid)
+{
+	Cpub	*cpub;
+	int	i, k;
+
+	if( n > 2 ) {
+		cmd_syntax_error();
+		return;
+	}
+	if( ckpt == NULL || ckpt_board >= net->n ) {
+		fprintf(stderr,"No checkpoint\n");
+		return;
+	}
+	cpub = &net->board[ckpt_board];
+	if( n == 1 ) {
+		for( i = 0 ; i < FORK_MAX ; i++ )
+			if( forks[i] != NULL )
+				fprintf(stderr,"\t%c%d  PC=0x%02x  lines=%d\n",
+					i == fork_on ? '*' : ' ',i,
+					i == fork_on ? cpub->pc : forks[i]->pc,
+					fork_lines(forks[i]));
+		return;
+	}
+	if( sscanf(strid,"%d",&k) != 1 || k < 0 || k >= FORK_MAX ) {
+		fprintf(stderr,"No such fork: %s\n",strid);
+		return;
+	}
+	if( forks[k] == NULL && (forks[k] = fork_new(ckpt)) == NULL ) {
+		fprintf(stderr,"Unable to allocate a fork\n");
+		return;
+	}
+	if( fork_leave(forks[fork_on],cpub) != 0 ) {
+		fprintf(stderr,"Unable to keep fork %d\n",fork_on);
+		return;
+	}
+	fork_enter(forks[k],cpub);
+	undo_clear(cpub->undo);
+	fork_on = k;
+	*id = ckpt_board;
+}
+
+
+/*=============================================================================
+ *   Command: Streaming I/O Devices of the Current Board
+ *
+ *	io			show the devices of the board
+ *	io in file [mmap]	feed ibuf from file (e.g. /dev/fd/3),
+ *				mapped whole with mmap; the board reads
+ *				the operator from now on
+ *	io out file		write the words of OUT to file ('-': stdout);
+ *				not while another board reads the obuf
+ *	io close		flush and close both
+ *
+ *   'c' stops with "End of Input." when the board waits at BNI after
+ *   the last byte.
+ *===========================================================================*/
+static void
+show_iodev(const char *port, IODev *dev)
+{
+	if( dev == NULL )
+		return;
+	fprintf(stderr,"\t%s: %s%s  %llu bytes%s\n",port,dev->name,
+			dev->mapped ? " (mmap)" : "",dev->bytes,
+			dev->eof ? "  end of file" :
+			dev->error ? "  write error" : "");
+}
+
+void
+io_command(int id, int n, char *arg1, char *arg2, char *arg3)
+{
+	Cpub	*cpub = &net->board[id];
+	IOBuf	*input = &net->input[id];	/* not another board's obuf */
+	IODev	*dev;
+	int	map, i;
+
+	if( n == 1 ) {
+		if( input->dev == NULL && cpub->obuf.dev == NULL )
+			fprintf(stderr,"\tno devices\n");
+		show_iodev("ibuf",input->dev);
+		show_iodev("obuf",cpub->obuf.dev);
+	} else if( n == 2 && !strcmp(arg1,"close") ) {
+		iodev_detach(input);
+		iodev_detach(&cpub->obuf);
+	} else if( (n == 3 || n == 4) && !strcmp(arg1,"in") ) {
+		map = (n == 4);
+		if( map && strcmp(arg3,"mmap") ) {
+			cmd_syntax_error();
+			return;
+		}
+		if( (dev = iodev_open(arg2,0,map)) == NULL )
+			return;
+		net_link(net,NET_OPERATOR,id);
+		iodev_attach(input,dev);
+	} else if( n == 3 && !strcmp(arg1,"out") ) {
+		for( i = 0 ; i < net->n && net->src[i] != id ; i++ )
+			;
+		if( i < net->n ) {	/* its words are the input of CPU i */
+			fprintf(stderr,"The obuf of CPU%d feeds CPU%d.\n",id,i);
+			return;
+		}
+		if( (dev = iodev_open(arg2,1,0)) == NULL )
+			return;
+		iodev_attach(&cpub->obuf,dev);
+	} else
+		cmd_syntax_error();
+}
+
+
+/*=============================================================================
+ *   Command: Show or Select the Execution Engine of 'c'
+ *===========================================================================*/
+void
+engine_command(int n, char *name)
+{
+	int	i;
+
+	if( n > 2 ) {
+		cmd_syntax_error();
+		return;
+	}
+	if( n == 2 ) {
+		for( i = 0 ; i < NENGINES ; i++ )
+			if( !strcmp(name,engines[i].name) )
+				break;
+		if( i == NENGINES ) {
+			fprintf(stderr,"Unknown engine: %s\n",name);
 			return;
 		}
-	} while( cpub->pc != breakp );
+		engine = i;
+	}
+	fprintf(stderr,"\tengine=%s\n",engines[engine].name);
 }
 
 
@@ -339,6 +1023,70 @@ display_mem_all(Cpub *cpub)
 }
 
 
+/*=============================================================================
+ *   Command: Disassemble the Program Area
+ *
+ *	u [addr [count]]	count (default 10) instructions from addr;
+ *				without addr, go on after the last listing
+ *				of the board (or from PC)
+ *
+ *   '>' marks PC and '*' a break-point.  A memory operand is followed by
+ *   the word it refers to now (IX-modified ones by the current IX).
+ *===========================================================================*/
+#define	DISASM_COUNT	0x10
+
+void
+disasm_mem(Cpub *cpub, int n, char *straddr, char *strcount)
+{
+	static const Cpub	*last = NULL;	/* board of the last listing */
+	static int		next;		/* ... and the address after it */
+	const InstructionInfo	*e;
+	const char		*text;
+	unsigned int		addr, count = DISASM_COUNT;
+	Addr			ea;
+	int			len;
+
+	addr = (last == cpub) ? (unsigned int)next : cpub->pc;
+	if( n >= 2 && (sscanf(straddr,"%x",&addr) != 1
+					|| addr >= IMEMORY_SIZE) ) {
+		fprintf(stderr,"Invalid address (out of range): %s\n",straddr);
+		return;
+	}
+	if( n == 3 && (sscanf(strcount,"%x",&count) != 1 || count == 0) ) {
+		fprintf(stderr,"Invalid count: %s\n",strcount);
+		return;
+	}
+
+	while( count-- > 0 ) {
+		text = disasm_line(cpub->mem,(Addr)addr,&len);
+		fprintf(stderr,"  %c%c %02x:  %02x",
+			addr == cpub->pc ? '>' : ' ',
+			BrkTest(cpub->brkmap,addr) ? '*' : ' ',
+			addr,cpub->mem[addr]);
+		if( len == 2 )
+			fprintf(stderr," %02x\t%s",cpub->mem[(addr+1) & 0xff],text);
+		else
+			fprintf(stderr,"   \t%s",text);
+
+		e = &decode_table[cpub->mem[addr]];
+		if( len == 2 && e->type >= INST_LD && e->type <= INST_EOR
+		 && e->addr_mode_b >= ADDR_MODE_ABS_PROG ) {
+			ea = cpub->mem[(addr+1) & 0xff];
+			if( e->addr_mode_b >= ADDR_MODE_IX_PROG )
+				ea = (ea + cpub->ix) & 0xff;
+			if( e->addr_mode_b == ADDR_MODE_ABS_DATA
+			 || e->addr_mode_b == ADDR_MODE_IX_DATA )
+				ea |= 0x100;
+			fprintf(stderr,"\t; %03x: %02x",ea,cpub->mem[ea]);
+		}
+		fprintf(stderr,"\n");
+		addr = (addr + len) & 0xff;
+	}
+	last = cpub;
+	next = (int)addr;
+}
+
+
 /*=============================================================================
  *   Command: Write a Word to a Memory Location
  *===========================================================================*/
@@ -360,65 +1108,301 @@ set_mem(Cpub *cpub, char *straddr, char *strval)
 	}
 
 	cpub->mem[addr] = value;
+	CodeWrite(cpub,addr);
 	display_mem_line(cpub,(Addr)MemLineBase(addr));
 }
 
 
 /*=============================================================================
- *   Command: Read a Program File
+ *   Command: Trace Control
+ *
+ *	trace [level]		show or set the text trace level
+ *	trace ring [n|off]	attach a binary trace ring of n records
+ *	trace dump [file]	render the ring, or save it for the decoder
+ *===========================================================================*/
+void
+trace_command(Cpub *cpub, int n, char *arg1, char *arg2)
+{
+	unsigned long	size, i;
+
+	if( n >= 2 && !strcmp(arg1,"ring") ) {
+		if( n == 3 && !strcmp(arg2,"off") ) {
+			trace_ring_free(cpub->trace);
+			cpub->trace = NULL;
+			return;
+		}
+		size = TRACE_RING_DEFAULT;
+		if( n == 3 && sscanf(arg2,"%lu",&size) != 1 ) {
+			cmd_syntax_error();
+			return;
+		}
+		if( size > TRACE_RING_MAX ) {
+			fprintf(stderr,"Invalid size (out of range): %s "
+				"(at most %lu records)\n",arg2,TRACE_RING_MAX);
+			return;
+		}
+		trace_ring_free(cpub->trace);
+		if( (cpub->trace = trace_ring_create(size)) == NULL )
+			fprintf(stderr,"Unable to allocate a trace ring\n");
+		else
+			fprintf(stderr,"\ttrace ring=%lu records\n",
+						cpub->trace->mask + 1);
+		return;
+	}
+	if( n >= 2 && !strcmp(arg1,"dump") ) {
+		if( cpub->trace == NULL ) {
+			fprintf(stderr,"No trace ring. Use \'trace ring\'.\n");
+			return;
+		}
+		if( n == 3 ) {
+			if( trace_ring_save(cpub->trace,arg2) != 0 )
+				fprintf(stderr,"Unable to write %s\n",arg2);
+			return;
+		}
+		for( i = 0 ; i < trace_ring_count(cpub->trace) ; i++ )
+			trace_render(stdout,trace_ring_get(cpub->trace,i));
+		fflush(stdout);
+		return;
+	}
+	if( n > 2 ) {
+		cmd_syntax_error();
+		return;
+	}
+	if( n == 2 ) {
+		switch( trace_set_level(arg1) ) {
+		   case -1:
+			fprintf(stderr,"Unknown trace level: %s\n",arg1);
+			return;
+		   case -2:
+			fprintf(stderr,"Trace level %s is not compiled in "
+					"(max: %s)\n",arg1,
+					trace_level_name(CPU_SIM_TRACE_MAX));
+			return;
+		}
+	}
+	fprintf(stderr,"\ttrace=%s\n",trace_level_name(trace_level));
+}
+
+
+/*=============================================================================
+ *   Command: Profile (see profile.h)
+ *
+ *	prof			print the sorted report
+ *	prof on|off		start counting from zero, or stop
+ *	prof clear		reset the counts
+ *	prof csv file		export the counts ("kind,key,count")
  *===========================================================================*/
 void
-read_mem_file(Cpub *cpub, char *file)
+prof_command(Cpub *cpub, int n, char *arg1, char *arg2)
 {
-#define	TOKENSIZE	160
-	FILE		*fp;
-	unsigned int	addr, word;
-	Addr		area;
-	char		token[TOKENSIZE];
+	if( n == 2 && !strcmp(arg1,"on") ) {
+		if( cpub->prof == NULL && (cpub->prof = prof_create()) == NULL )
+			fprintf(stderr,"Unable to allocate a profile\n");
+		prof_clear(cpub->prof);
+		return;
+	}
+	if( n == 2 && !strcmp(arg1,"off") ) {
+		prof_free(cpub->prof);
+		cpub->prof = NULL;
+		return;
+	}
+	if( n > 3 || (n == 2 && strcmp(arg1,"clear"))
+	 || (n == 3 && strcmp(arg1,"csv")) ) {
+		cmd_syntax_error();
+		return;
+	}
+	if( cpub->prof == NULL ) {
+		fprintf(stderr,"No profile. Use \'prof on\'.\n");
+		return;
+	}
+	if( n == 2 )
+		prof_clear(cpub->prof);
+	else if( n == 3 ) {
+		if( prof_save_csv(cpub->prof,arg2) != 0 )
+			fprintf(stderr,"Unable to write %s\n",arg2);
+	} else {
+		prof_report(stdout,cpub->prof);
+		fflush(stdout);
+	}
+}
+
+
+/*=============================================================================
+ *   Command: Timing Model (see timing.h)
+ *
+ *	cycles			show the cycles counted and the runtime
+ *	cycles on [Hz]		count from zero with a clock of Hz
+ *	cycles off		stop counting
+ *	cycles clear		reset the count
+ *===========================================================================*/
+void
+cycles_command(Cpub *cpub, int n, char *arg1, char *arg2)
+{
+	unsigned long	hz = TIMING_HZ;
 
-	if( (fp = fopen(file,"r")) == NULL ) {
-		fprintf(stderr,"Unable to open %s\n",file);
+	if( n >= 2 && !strcmp(arg1,"on") ) {
+		if( n == 3 && (sscanf(arg2,"%lu",&hz) != 1 || hz == 0) ) {
+			cmd_syntax_error();
+			return;
+		}
+		timing_free(cpub->timing);
+		if( (cpub->timing = timing_create(hz)) == NULL ) {
+			fprintf(stderr,"Unable to allocate a timing model\n");
+			return;
+		}
+	} else if( n == 2 && !strcmp(arg1,"off") ) {
+		timing_free(cpub->timing);
+		cpub->timing = NULL;
+		return;
+	} else if( n > 2 || (n == 2 && strcmp(arg1,"clear")) ) {
+		cmd_syntax_error();
+		return;
+	}
+	if( cpub->timing == NULL ) {
+		fprintf(stderr,"No cycle count. Use \'cycles on\'.\n");
 		return;
 	}
+	if( n == 2 && !strcmp(arg1,"clear") )
+		timing_clear(cpub->timing);
+	timing_report(stderr,cpub->timing);
+}
 
-	addr = 0;	/* default initial address */
-	while( fscanf(fp,"%s",token) == 1 ) {
-		if( token[0] == '.' ) {		/* directive */
-			/*
-			 *   Check the directive type
-			 */
-			if( !strcmp(token+1,"text") ) {
-				area = 0x000;
-			} else
-			if( !strcmp(token+1,"data") ) {
-				area = 0x100;
-			} else {
-				fprintf(stderr,"Unknown directive: %s\n",token);				goto error;
-			}
 
-			/*
-			 *   Change the current address
-			 */
-			fscanf(fp,"%x",&addr);
-			if( addr > 0xff ) {
-				fprintf(stderr,"Invalid address: %s %x\n",
-								token,addr);
-				goto error;
+/*=============================================================================
+ *   Command: Break-points and Watch-points
+ *
+ *	bp [addr [cond]]	list, or set a break-point (stopping only if
+ *				cond holds, e.g. "acc==0f"; several conditions
+ *				at one address are or-ed)
+ *	bd addr|all		delete break-points
+ *	wp [addr]		list, or stop after an ST writes the address
+ *	wd addr|all		delete watch-points
+ *===========================================================================*/
+void
+debug_command(Cpub *cpub, int n, char *cmd, char *arg1, char *arg2)
+{
+	DebugPoints	*dp;
+	BrkCond		cond;
+	unsigned int	addr, limit;
+	int		all;
+
+	if( n == 1 && cmd[1] == 'p' ) {
+		list_debug_points(cpub);
+		return;
+	}
+	if( n != 2 && !(n == 3 && cmd[0] == 'b' && cmd[1] == 'p') ) {
+		cmd_syntax_error();
+		return;
+	}
+
+	/*
+	 *   Check the address
+	 */
+	limit = (cmd[0] == 'b') ? IMEMORY_SIZE : MEMORY_SIZE;
+	all = (cmd[1] == 'd' && !strcmp(arg1,"all"));
+	if( !all && (sscanf(arg1,"%x",&addr) != 1 || addr >= limit) ) {
+		fprintf(stderr,"Invalid address (out of range): %s\n",arg1);
+		return;
+	}
+
+	if( cmd[0] == 'b' ) {
+		/*
+		 *   Break-points
+		 */
+		dp = cpub->debug;
+		if( cmd[1] == 'd' && all ) {
+			memset(cpub->brkmap,0,sizeof(cpub->brkmap));
+			if( dp != NULL ) {
+				memset(dp->condmap,0,sizeof(dp->condmap));
+				dp->ncond = 0;
+			}
+		} else if( cmd[1] == 'd' ) {
+			BrkClear(cpub->brkmap,addr);
+			debug_cond_remove(cpub,addr);
+		} else if( n == 2 ) {
+			debug_cond_remove(cpub,addr);
+			BrkSet(cpub->brkmap,addr);
+		} else {
+			if( debug_cond_parse(arg2,&cond) != 0 ) {
+				fprintf(stderr,"Invalid condition: %s\n",arg2);
+				return;
 			}
-			addr |= area;
-		} else {			/* instruction word or data */
-			sscanf(token,"%x",&word);
-			if( word > 0xff ) {
-				fprintf(stderr,"Invalid value at addr=0x%03x: "
-							"0x%x\n",addr,word);
-				goto error;
+			if( BrkTest(cpub->brkmap,addr)
+			 && (dp == NULL || !BrkTest(dp->condmap,addr)) ) {
+				fprintf(stderr,"Break-point at 0x%02x is "
+					"unconditional. Delete it first.\n",addr);
+				return;
+			}
+			cond.addr = addr;
+			if( debug_cond_add(cpub,&cond) != 0 ) {
+				fprintf(stderr,"Too many break-point "
+							"conditions\n");
+				return;
 			}
-			cpub->mem[addr++] = word;
+		}
+	} else {
+		/*
+		 *   Watch-points
+		 */
+		if( (dp = debug_points(cpub)) == NULL ) {
+			fprintf(stderr,"Unable to allocate watch-points\n");
+			return;
+		}
+		if( cmd[1] == 'd' && all ) {
+			memset(dp->watchmap,0,sizeof(dp->watchmap));
+			dp->nwatch = 0;
+		} else if( cmd[1] == 'd' ) {
+			if( BrkTest(dp->watchmap,addr) ) {
+				BrkClear(dp->watchmap,addr);
+				dp->nwatch--;
+			}
+		} else if( !BrkTest(dp->watchmap,addr) ) {
+			BrkSet(dp->watchmap,addr);
+			dp->nwatch++;
 		}
 	}
+}
+
+
+void
+list_debug_points(Cpub *cpub)
+{
+	const DebugPoints	*dp = cpub->debug;
+	unsigned int		addr;
+	int			i, first;
+
+	for( addr = 0 ; addr < IMEMORY_SIZE ; addr++ ) {
+		if( !BrkTest(cpub->brkmap,addr) )
+			continue;
+		fprintf(stderr,"\tbreak 0x%02x",addr);
+		if( dp != NULL && BrkTest(dp->condmap,addr) ) {
+			first = 1;
+			for( i = 0 ; i < dp->ncond ; i++ ) {
+				if( dp->cond[i].addr != addr )
+					continue;
+				fprintf(stderr,first ? " if " : " || ");
+				debug_cond_print(stderr,&dp->cond[i]);
+				first = 0;
+			}
+		}
+		fprintf(stderr,"\n");
+	}
+	if( dp == NULL )
+		return;
+	for( addr = 0 ; addr < MEMORY_SIZE ; addr++ )
+		if( BrkTest(dp->watchmap,addr) )
+			fprintf(stderr,"\twatch 0x%03x\n",addr);
+}
+
+
+void
+report_watch(Cpub *cpub)
+{
+	Addr	addr = cpub->debug->hit_addr;
 
-     error:
-	fclose(fp);
+	fprintf(stderr,"Watch-point: 0x%03x <- 0x%02x (PC=0x%02x).\n",
+						addr,cpub->mem[addr],cpub->pc);
+	cpub->debug->hit = 0;
 }
 
 
@@ -0,0 +1,91 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	mkimage.c
+ *	Descrioption:	converter of program files into images
+ */
+
+#define	_POSIX_C_SOURCE	200809L	/* getopt() */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<unistd.h>
+#include	"cpuboard.h"
+#include	"loader.h"
+
+
+/*=============================================================================
+ *   Main Routine: cpu_sim_mkimage [-p pc] [-a acc] [-x ix] [-f flags]
+ *							program image
+ *
+ *   Writes the words loaded from a program file (text, or an image) and
+ *   the initial registers (hex; flags: cf,vf,nf,zf in bits 3..0) to an
+ *   image for read_mem_file().  Registers not given are those of the
+ *   program: 0 for a text file.
+ *===========================================================================*/
+static Cpub	board;
+static Uword	map[MEMORY_SIZE/8];
+
+static int
+hex_option(const char *arg, unsigned int max, unsigned int *value)
+{
+	return sscanf(arg,"%x",value) == 1 && *value <= max ? 0 : -1;
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned int	pc, acc, ix, flags;
+	int		c, bad = 0;
+	int		set_pc = 0, set_acc = 0, set_ix = 0, set_flags = 0;
+
+	while( (c = getopt(argc,argv,"p:a:x:f:")) != -1 ) {
+		switch( c ) {
+		   case 'p':
+			bad |= hex_option(optarg,0xff,&pc);
+			set_pc = 1;
+			break;
+		   case 'a':
+			bad |= hex_option(optarg,0xff,&acc);
+			set_acc = 1;
+			break;
+		   case 'x':
+			bad |= hex_option(optarg,0xff,&ix);
+			set_ix = 1;
+			break;
+		   case 'f':
+			bad |= hex_option(optarg,0xf,&flags);
+			set_flags = 1;
+			break;
+		   default:
+			bad = -1;
+			break;
+		}
+	}
+	if( bad || argc - optind != 2 ) {
+		fprintf(stderr,"usage: %s [-p pc] [-a acc] [-x ix] [-f flags] "
+					"program image\n",argv[0]);
+		return 2;
+	}
+
+	if( read_mem_map(&board,argv[optind],map) != 0 )
+		return 1;
+	if( set_pc )
+		board.pc = pc;
+	if( set_acc )
+		board.acc = acc;
+	if( set_ix )
+		board.ix = ix;
+	if( set_flags ) {
+		board.cf = (flags >> 3) & 1;
+		board.vf = (flags >> 2) & 1;
+		board.nf = (flags >> 1) & 1;
+		board.zf = flags & 1;
+	}
+	if( write_mem_image(&board,map,argv[optind+1]) != 0 ) {
+		fprintf(stderr,"Unable to write %s\n",argv[optind+1]);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,378 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	network.c
+ *	Descrioption:	networks of CPU boards and their scheduler
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<pthread.h>
+#include	"cpuboard.h"
+#include	"trace.h"
+#include	"debug.h"
+#include	"block.h"
+#include	"loader.h"
+#include	"iodev.h"
+#include	"undo.h"
+#include	"profile.h"
+#include	"timing.h"
+#include	"network.h"
+
+
+/*=============================================================================
+ *   Creation and Connection
+ *===========================================================================*/
+Network *
+net_new(int n)
+{
+	Network	*net;
+
+	if( n <= 0 || n > NET_MAX_BOARDS
+	 || (net = calloc(1,sizeof(Network))) == NULL )
+		return NULL;
+	net->n = n;
+	net->board = calloc(n,sizeof(Cpub));
+	net->src = calloc(n,sizeof(int));
+	net->input = calloc(n,sizeof(IOBuf));
+	net->halted = calloc(n,1);
+	if( net->board == NULL || net->src == NULL || net->input == NULL
+	 || net->halted == NULL ) {
+		net_free(net);
+		return NULL;
+	}
+	net->quantum = NET_QUANTUM;
+	net->stopped = -1;
+	net_topology(net,"ring");
+	return net;
+}
+
+
+void
+net_free(Network *net)
+{
+	int	i;
+
+	if( net == NULL )
+		return;
+	for( i = 0 ; net->board != NULL && i < net->n ; i++ ) {
+		trace_ring_free(net->board[i].trace);
+		free(net->board[i].debug);
+		block_free(&net->board[i]);
+		undo_free(net->board[i].undo);
+		prof_free(net->board[i].prof);
+		timing_free(net->board[i].timing);
+		iodev_detach(&net->board[i].obuf);
+		iodev_detach(&net->input[i]);
+	}
+	free(net->board);
+	free(net->src);
+	free(net->input);
+	free(net->halted);
+	free(net);
+}
+
+
+/*
+ *   Point the ibuf of every board at the obuf feeding it (after src[]
+ *   changes)
+ */
+void
+net_connect(Network *net)
+{
+	int	i;
+
+	for( i = 0 ; i < net->n ; i++ )
+		net->board[i].ibuf = (net->src[i] == NET_OPERATOR)
+			? &net->input[i] : &net->board[net->src[i]].obuf;
+}
+
+
+/*
+ *   A board whose obuf feeds more than one board, or -1
+ */
+static int
+net_shared(const Network *net)
+{
+	int	i, j;
+
+	for( i = 0 ; i < net->n ; i++ )
+		for( j = i + 1 ; j < net->n ; j++ )
+			if( net->src[i] != NET_OPERATOR
+			 && net->src[i] == net->src[j] )
+				return net->src[i];
+	return -1;
+}
+
+
+/*
+ *   Connect the boards as "ring", "chain", "star" or "mesh WxH"
+ */
+int
+net_topology(Network *net, const char *spec)
+{
+	char	name[16];
+	int	i, w = 0, h = 0, n = net->n;
+
+	if( sscanf(spec,"%15s %dx%d",name,&w,&h) < 1 )
+		return -1;
+	if( !strcmp(name,"ring") ) {
+		for( i = 0 ; i < n ; i++ )
+			net->src[i] = (i + n - 1) % n;
+	} else if( !strcmp(name,"chain") ) {
+		for( i = 0 ; i < n ; i++ )
+			net->src[i] = i - 1;
+	} else if( !strcmp(name,"star") ) {
+		net->src[0] = NET_OPERATOR;
+		for( i = 1 ; i < n ; i++ )
+			net->src[i] = 0;
+	} else if( !strcmp(name,"mesh") ) {
+		if( w <= 0 || h <= 0 || w * h != n )
+			return -1;
+		for( i = 0 ; i < n ; i++ )
+			net->src[i] = (i % w) ? i - 1 : i - w;
+		net->src[0] = NET_OPERATOR;
+	} else
+		return -1;
+
+	snprintf(net->topology,sizeof(net->topology),"%s",spec);
+	net_connect(net);
+	return 0;
+}
+
+
+/*
+ *   Feed board to from board from (NET_OPERATOR: by hand)
+ */
+int
+net_link(Network *net, int from, int to)
+{
+	if( from < NET_OPERATOR || from >= net->n || to < 0 || to >= net->n )
+		return -1;
+	net->src[to] = from;
+	net_connect(net);
+	return 0;
+}
+
+
+/*=============================================================================
+ *   Configuration File
+ *
+ *	boards n		number of boards (first; default 2)
+ *	topology name [WxH]	ring (default), chain, star or mesh
+ *	link from to		board to reads board from ('-': the operator)
+ *	load board file		program of a board (the format of 'r')
+ *	quantum n		instructions of a board per turn
+ *	threads n		run the boards on n threads
+ *
+ *   Empty lines and lines starting with '#' are skipped.  Threads need
+ *   every obuf to feed at most one board (not a star).
+ *===========================================================================*/
+#define	CFGSIZE	256
+
+Network *
+net_read_config(const char *file)
+{
+	FILE		*fp;
+	Network		*net = NULL;
+	char		line[CFGSIZE], key[CFGSIZE], arg1[CFGSIZE], arg2[CFGSIZE];
+	char		*rest;
+	int		n, lineno = 0, from, to;
+	unsigned long long	value;
+
+	if( (fp = fopen(file,"r")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		return NULL;
+	}
+	while( fgets(line,CFGSIZE,fp) != NULL ) {
+		lineno++;
+		if( (n = sscanf(line,"%s%s%s",key,arg1,arg2)) <= 0
+		 || key[0] == '#' )
+			continue;
+		if( net == NULL ) {
+			if( !strcmp(key,"boards") ) {
+				if( n != 2 || (net = net_new(atoi(arg1))) == NULL )
+					goto error;
+				continue;
+			}
+			if( (net = net_new(2)) == NULL )
+				goto error;
+		}
+
+		if( !strcmp(key,"topology") && n >= 2 ) {
+			rest = strstr(line,arg1);
+			rest[strcspn(rest,"\r\n#")] = '\0';
+			if( net_topology(net,rest) != 0 )
+				goto error;
+		} else if( !strcmp(key,"link") && n == 3 ) {
+			from = !strcmp(arg1,"-") ? NET_OPERATOR : atoi(arg1);
+			to = atoi(arg2);
+			if( net_link(net,from,to) != 0 )
+				goto error;
+		} else if( !strcmp(key,"load") && n == 3 ) {
+			to = atoi(arg1);
+			if( to < 0 || to >= net->n
+			 || read_mem_file(&net->board[to],arg2) != 0 )
+				goto error;
+		} else if( !strcmp(key,"quantum") && n == 2
+			&& sscanf(arg1,"%llu",&value) == 1 && value > 0 ) {
+			net->quantum = value;
+		} else if( !strcmp(key,"threads") && n == 2 ) {
+			net->threads = atoi(arg1);
+		} else
+			goto error;
+	}
+	fclose(fp);
+	if( net == NULL )
+		net = net_new(2);
+	if( net != NULL && net->threads > 1 && (n = net_shared(net)) >= 0 ) {
+		fprintf(stderr,"%s: board %d feeds several boards, which "
+				"cannot run on threads\n",file,n);
+		net_free(net);
+		return NULL;
+	}
+	return net;
+
+     error:
+	fprintf(stderr,"%s:%d: invalid line: %s",file,lineno,line);
+	fclose(fp);
+	net_free(net);
+	return NULL;
+}
+
+
+/*=============================================================================
+ *   Scheduler: Run All Boards until They Halt, a Break or the Limit
+ *
+ *   The boards take turns of quantum instructions.  With threads, board
+ *   i belongs to thread i % threads, and the threads share the limit by
+ *   taking a quantum of it at a time.  The run goes on from where the
+ *   last one stopped: boards that have halted (halted[]) are skipped, so
+ *   clear halted[] to start over.  limit and *count are the instructions
+ *   of all boards together.
+ *===========================================================================*/
+typedef struct sched {
+	Network			*net;
+	RunEngine		*run;
+	unsigned long long	limit, total;
+	pthread_mutex_t		lock;		/* total, stop, net->stopped */
+	int			stop;
+	int			nthreads;
+} Sched;
+
+typedef struct schedthread {
+	pthread_t	thread;
+	Sched		*s;
+	int		first;		/* boards first, first+nthreads, .. */
+} SchedThread;
+
+/* run the boards of a thread in turn; 0 when they have all halted */
+static int
+sched_turns(Sched *s, int first)
+{
+	Network			*net = s->net;
+	unsigned long long	q, k;
+	int			i, busy, result;
+
+	do {
+		busy = 0;
+		for( i = first ; i < net->n ; i += s->nthreads ) {
+			if( net->halted[i] )
+				continue;
+			busy = 1;
+
+			pthread_mutex_lock(&s->lock);
+			if( s->stop || s->total >= s->limit ) {
+				pthread_mutex_unlock(&s->lock);
+				return 1;
+			}
+			q = s->limit - s->total;
+			if( q > net->quantum )
+				q = net->quantum;
+			s->total += q;
+			pthread_mutex_unlock(&s->lock);
+
+			result = s->run(&net->board[i],q,&k);
+
+			pthread_mutex_lock(&s->lock);
+			s->total -= q - k;
+			if( result == RUN_HALT )
+				net->halted[i] = 1;
+			else if( result == RUN_BREAK && !s->stop ) {
+				s->stop = 1;
+				net->stopped = i;
+			}
+			pthread_mutex_unlock(&s->lock);
+		}
+	} while( busy );
+	return 0;
+}
+
+static void *
+sched_main(void *arg)
+{
+	SchedThread	*t = arg;
+
+	sched_turns(t->s,t->first);
+	return NULL;
+}
+
+int
+run_network(Network *net, RunEngine *run, unsigned long long limit,
+					unsigned long long *count)
+{
+	SchedThread	t[NET_MAX_BOARDS];
+	Sched		s;
+	int		i, started;
+
+	s.net = net;
+	s.run = run;
+	s.limit = limit;
+	s.total = 0;
+	s.stop = 0;
+	s.nthreads = net->threads > 1 ? net->threads : 1;
+	if( s.nthreads > net->n )
+		s.nthreads = net->n;
+	if( net_shared(net) >= 0 )	/* readers would race for a word */
+		s.nthreads = 1;
+	pthread_mutex_init(&s.lock,NULL);
+	net->stopped = -1;
+
+	if( s.nthreads > 1 ) {
+		run_threaded(NULL,0,NULL);	/* dispatch tables first */
+		run_block(NULL,0,NULL);
+	}
+	for( i = 1, started = 1 ; i < s.nthreads ; i++ ) {
+		t[i].s = &s;
+		t[i].first = i;
+		if( pthread_create(&t[i].thread,NULL,sched_main,&t[i]) != 0 )
+			break;
+		started++;
+	}
+	if( started < s.nthreads ) {	/* run the rest here, one by one */
+		fprintf(stderr,"Unable to start a scheduler thread\n");
+		pthread_mutex_lock(&s.lock);
+		s.stop = 1;
+		pthread_mutex_unlock(&s.lock);
+		for( i = 1 ; i < started ; i++ )
+			pthread_join(t[i].thread,NULL);
+		s.nthreads = 1;			/* no thread reads it now */
+		s.stop = (net->stopped >= 0);
+		started = 1;
+	}
+	sched_turns(&s,0);
+	for( i = 1 ; i < started ; i++ )
+		pthread_join(t[i].thread,NULL);
+	pthread_mutex_destroy(&s.lock);
+
+	if( count != NULL )
+		*count = s.total;
+	if( net->stopped >= 0 )
+		return RUN_BREAK;
+	for( i = 0 ; i < net->n ; i++ )
+		if( !net->halted[i] )
+			return RUN_STEP;
+	return RUN_HALT;
+}
@@ -0,0 +1,171 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	profile.c
+ *	Descrioption:	execution profile of a board (instructions, PCs,
+ *			branches and memory accesses)
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	"cpuboard.h"
+#include	"profile.h"
+
+static const char	*type_names[PROF_TYPES] = {
+	"NOP", "HLT", "OUT", "IN", "RCF", "SCF", "LD", "ST", "ADD", "ADC",
+	"SUB", "SBC", "CMP", "AND", "OR", "EOR", "Ssm", "Rsm", "Bbc", "JAL",
+	"JR", "unknown"
+};
+static const char	*mode_names[PROF_MODES] = {
+	"ACC", "IX", "d", "[d]", "(d)", "[IX+d]", "(IX+d)", "none"
+};
+static const char	*cond_names[PROF_CONDS] = {
+	"BA", "BVF", "BNZ", "BZ", "BZP", "BN", "BP", "BZN", "BNI", "BNO",
+	"BNC", "BC", "BGE", "BLT", "BGT", "BLE", "never"
+};
+
+
+/*=============================================================================
+ *   Profiles
+ *===========================================================================*/
+Profile *
+prof_create(void)
+{
+	return calloc(1,sizeof(Profile));
+}
+
+
+void
+prof_free(Profile *p)
+{
+	free(p);
+}
+
+
+void
+prof_clear(Profile *p)
+{
+	if( p != NULL )
+		memset(p,0,sizeof(Profile));
+}
+
+
+/*=============================================================================
+ *   Report
+ *===========================================================================*/
+/*
+ *   Indices of the (at most k) largest non-zero counts, largest first;
+ *   returns how many
+ */
+static int
+prof_top(const unsigned long long *v, int n, int *idx, int k)
+{
+	int	i, j, m = 0;
+
+	for( i = 0 ; i < n ; i++ ) {
+		if( v[i] == 0 || (m == k && v[i] <= v[idx[m-1]]) )
+			continue;
+		for( j = (m < k) ? m++ : m - 1 ; j > 0 && v[idx[j-1]] < v[i] ; j-- )
+			idx[j] = idx[j-1];
+		idx[j] = i;
+	}
+	return m;
+}
+
+static double
+percent(unsigned long long n, unsigned long long total)
+{
+	return total ? 100.0 * n / total : 0.0;
+}
+
+void
+prof_report(FILE *fp, const Profile *p)
+{
+	unsigned long long	sum[MEMORY_SIZE];
+	int			idx[MEMORY_SIZE];
+	int			i, n;
+
+	fprintf(fp,"\t%llu instructions\n",p->total);
+
+	fprintf(fp,"\n\tinstruction\t      count\t     %%\n");
+	n = prof_top(p->type,PROF_TYPES,idx,PROF_TYPES);
+	for( i = 0 ; i < n ; i++ )
+		fprintf(fp,"\t%-8s\t%11llu\t%6.2f\n",type_names[idx[i]],
+			p->type[idx[i]],percent(p->type[idx[i]],p->total));
+
+	fprintf(fp,"\n\tmode B\t\t      count\t     %%\n");
+	n = prof_top(p->mode,PROF_MODES,idx,PROF_MODES);
+	for( i = 0 ; i < n ; i++ )
+		fprintf(fp,"\t%-8s\t%11llu\t%6.2f\n",mode_names[idx[i]],
+			p->mode[idx[i]],percent(p->mode[idx[i]],p->total));
+
+	fprintf(fp,"\n\tPC\t\t      count\t     %%\n");
+	n = prof_top(p->pc,IMEMORY_SIZE,idx,PROF_TOP);
+	for( i = 0 ; i < n ; i++ )
+		fprintf(fp,"\t0x%02x\t\t%11llu\t%6.2f\n",idx[i],
+			p->pc[idx[i]],percent(p->pc[idx[i]],p->total));
+
+	for( i = 0 ; i < PROF_CONDS ; i++ )
+		sum[i] = p->branch[i][0] + p->branch[i][1];
+	n = prof_top(sum,PROF_CONDS,idx,PROF_CONDS);
+	if( n > 0 )
+		fprintf(fp,"\n\tbranch\t\t      taken\t  not taken\n");
+	for( i = 0 ; i < n ; i++ )
+		fprintf(fp,"\t%-8s\t%11llu\t%11llu\n",cond_names[idx[i]],
+			p->branch[idx[i]][1],p->branch[idx[i]][0]);
+
+	for( i = 0 ; i < MEMORY_SIZE ; i++ )
+		sum[i] = p->read[i] + p->write[i];
+	n = prof_top(sum,MEMORY_SIZE,idx,PROF_TOP);
+	if( n > 0 )
+		fprintf(fp,"\n\tmemory\t\t       read\t      write\n");
+	for( i = 0 ; i < n ; i++ )
+		fprintf(fp,"\t0x%03x\t\t%11llu\t%11llu\n",idx[i],
+			p->read[idx[i]],p->write[idx[i]]);
+}
+
+
+/*
+ *   CSV: one "kind,key,count" line per non-zero counter
+ *
+ *	type,<InstructionType>	mode,<AddressingMode>	pc,0x<PC>
+ *	taken,<condition>	not-taken,<condition>
+ *	read,0x<address>	write,0x<address>
+ */
+int
+prof_save_csv(const Profile *p, const char *file)
+{
+	FILE	*fp;
+	int	i;
+
+	if( (fp = fopen(file,"w")) == NULL )
+		return -1;
+	fprintf(fp,"kind,key,count\n");
+	fprintf(fp,"total,,%llu\n",p->total);
+	for( i = 0 ; i < PROF_TYPES ; i++ )
+		if( p->type[i] )
+			fprintf(fp,"type,%s,%llu\n",type_names[i],p->type[i]);
+	for( i = 0 ; i < PROF_MODES ; i++ )
+		if( p->mode[i] )
+			fprintf(fp,"mode,%s,%llu\n",mode_names[i],p->mode[i]);
+	for( i = 0 ; i < IMEMORY_SIZE ; i++ )
+		if( p->pc[i] )
+			fprintf(fp,"pc,0x%02x,%llu\n",i,p->pc[i]);
+	for( i = 0 ; i < PROF_CONDS ; i++ ) {
+		if( p->branch[i][1] )
+			fprintf(fp,"taken,%s,%llu\n",cond_names[i],
+							p->branch[i][1]);
+		if( p->branch[i][0] )
+			fprintf(fp,"not-taken,%s,%llu\n",cond_names[i],
+							p->branch[i][0]);
+	}
+	for( i = 0 ; i < MEMORY_SIZE ; i++ ) {
+		if( p->read[i] )
+			fprintf(fp,"read,0x%03x,%llu\n",i,p->read[i]);
+		if( p->write[i] )
+			fprintf(fp,"write,0x%03x,%llu\n",i,p->write[i]);
+	}
+	return fclose(fp) == 0 ? 0 : -1;
+}
@@ -0,0 +1,238 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	snapshot.c
+ *	Descrioption:	snapshots of the boards and their connections
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	"cpuboard.h"
+#include	"network.h"
+#include	"snapshot.h"
+
+
+/*=============================================================================
+ *   Little-Endian Fields
+ *===========================================================================*/
+static void
+put_le(unsigned char *p, unsigned long long value, int bytes)
+{
+	int	i;
+
+	for( i = 0 ; i < bytes ; i++ )
+		p[i] = (unsigned char)(value >> (8*i));
+}
+
+static unsigned long long
+get_le(const unsigned char *p, int bytes)
+{
+	unsigned long long	value = 0;
+	int			i;
+
+	for( i = 0 ; i < bytes ; i++ )
+		value |= (unsigned long long)p[i] << (8*i);
+	return value;
+}
+
+
+/*=============================================================================
+ *   A Board
+ *
+ *   input is the operator input of the board (NULL: none), src the board
+ *   feeding it.
+ *===========================================================================*/
+void
+snap_encode_board(Cpub *cpub, const IOBuf *input, int src, unsigned char *rec)
+{
+	FlagSync(cpub);
+	memset(rec,0,SNAP_RECORD);
+	rec[0] = cpub->pc;
+	rec[1] = cpub->acc;
+	rec[2] = cpub->ix;
+	rec[3] = (cpub->cf << 3) | (cpub->vf << 2) | (cpub->nf << 1) | cpub->zf;
+	if( input != NULL ) {
+		rec[4] = input->flag;
+		rec[5] = input->buf;
+	}
+	rec[6] = cpub->obuf.flag;
+	rec[7] = cpub->obuf.buf;
+	put_le(rec + 8,(unsigned)src & 0xffff,2);
+	memcpy(rec + 16,cpub->mem,MEMORY_SIZE);
+}
+
+
+void
+snap_decode_board(Cpub *cpub, IOBuf *input, const unsigned char *rec)
+{
+	const Uword	*mem = rec + 16;
+	int		addr;
+
+	cpub->pc = rec[0];
+	cpub->acc = rec[1];
+	cpub->ix = rec[2];
+	cpub->cf = (rec[3] >> 3) & 1;
+	cpub->vf = (rec[3] >> 2) & 1;
+	cpub->nf = (rec[3] >> 1) & 1;
+	cpub->zf = rec[3] & 1;
+	cpub->flag_op = FLAGS_VALID;
+	if( input != NULL ) {
+		input->flag = rec[4] & 1;
+		input->buf = rec[5];
+	}
+	cpub->obuf.flag = rec[6] & 1;
+	cpub->obuf.buf = rec[7];
+
+	for( addr = 0 ; addr < IMEMORY_SIZE ; addr++ )
+		if( cpub->mem[addr] != mem[addr] )
+			CodeWrite(cpub,addr);
+	memcpy(cpub->mem,mem,MEMORY_SIZE);
+}
+
+
+/*=============================================================================
+ *   A Network (SnapSize(net->n) bytes)
+ *===========================================================================*/
+void
+snap_encode(Network *net, unsigned char *buf)
+{
+	int	i;
+
+	memset(buf,0,SNAP_HEADER);
+	memcpy(buf,SNAP_MAGIC,8);
+	put_le(buf + 8,net->n,2);
+	put_le(buf + 10,net->threads > 0 ? net->threads : 0,2);
+	put_le(buf + 12,net->quantum,8);
+	strncpy((char *)buf + 20,net->topology,32);
+	for( i = 0 ; i < net->n ; i++ )
+		snap_encode_board(&net->board[i],&net->input[i],net->src[i],
+					buf + SNAP_HEADER + i * SNAP_RECORD);
+}
+
+
+/*
+ *   Restore a network of as many boards; -1 if buf is not a snapshot of one
+ */
+int
+snap_decode(Network *net, const unsigned char *buf, size_t size)
+{
+	const unsigned char	*rec;
+	int			i, src;
+
+	if( size < SNAP_HEADER || memcmp(buf,SNAP_MAGIC,8) != 0
+	 || (int)get_le(buf + 8,2) != net->n || size != SnapSize(net->n)
+	 || get_le(buf + 12,8) == 0 )
+		return -1;
+	for( i = 0 ; i < net->n ; i++ ) {
+		src = (int)get_le(buf + SNAP_HEADER + i * SNAP_RECORD + 8,2);
+		if( src != 0xffff && src >= net->n )
+			return -1;
+	}
+
+	net->threads = (int)get_le(buf + 10,2);
+	net->quantum = get_le(buf + 12,8);
+	memcpy(net->topology,buf + 20,32);
+	net->topology[sizeof(net->topology) - 1] = '\0';
+	for( i = 0 ; i < net->n ; i++ ) {
+		rec = buf + SNAP_HEADER + i * SNAP_RECORD;
+		src = (int)get_le(rec + 8,2);
+		net->src[i] = (src == 0xffff) ? NET_OPERATOR : src;
+		snap_decode_board(&net->board[i],&net->input[i],rec);
+	}
+	net_connect(net);
+	return 0;
+}
+
+
+/*=============================================================================
+ *   Files
+ *===========================================================================*/
+/*
+ *   Read a snapshot file into a buffer of *size bytes (NULL on an error)
+ */
+unsigned char *
+snap_read(const char *file, size_t *size)
+{
+	FILE		*fp;
+	unsigned char	hdr[SNAP_HEADER], *buf = NULL;
+	int		n;
+
+	if( (fp = fopen(file,"rb")) == NULL ) {
+		fprintf(stderr,"Unable to open %s\n",file);
+		return NULL;
+	}
+	if( fread(hdr,1,SNAP_HEADER,fp) != SNAP_HEADER
+	 || memcmp(hdr,SNAP_MAGIC,8) != 0
+	 || (n = (int)get_le(hdr + 8,2)) <= 0 || n > NET_MAX_BOARDS
+	 || (buf = malloc(SnapSize(n))) == NULL
+	 || fread(buf + SNAP_HEADER,SNAP_RECORD,n,fp) != (size_t)n
+	 || getc(fp) != EOF ) {
+		fprintf(stderr,"%s: not a snapshot\n",file);
+		free(buf);
+		fclose(fp);
+		return NULL;
+	}
+	fclose(fp);
+	memcpy(buf,hdr,SNAP_HEADER);
+	*size = SnapSize(n);
+	return buf;
+}
+
+
+int
+snap_save(Network *net, const char *file)
+{
+	FILE		*fp;
+	unsigned char	*buf;
+	size_t		size = SnapSize(net->n);
+	int		result = -1;
+
+	if( (buf = malloc(size)) == NULL )
+		return -1;
+	snap_encode(net,buf);
+	if( (fp = fopen(file,"wb")) != NULL ) {
+		if( fwrite(buf,1,size,fp) == size )
+			result = 0;
+		if( fclose(fp) != 0 )
+			result = -1;
+	}
+	if( result != 0 )
+		fprintf(stderr,"Unable to write %s\n",file);
+	free(buf);
+	return result;
+}
+
+
+/*
+ *   Restore *netp from a file, in place if the number of boards is the
+ *   same and in a new network (replacing *netp) otherwise
+ */
+int
+snap_load(Network **netp, const char *file)
+{
+	Network		*net = *netp;
+	unsigned char	*buf;
+	size_t		size;
+	int		result;
+
+	if( (buf = snap_read(file,&size)) == NULL )
+		return -1;
+	if( (int)get_le(buf + 8,2) != net->n
+	 && (net = net_new((int)get_le(buf + 8,2))) == NULL ) {
+		free(buf);
+		return -1;
+	}
+	if( (result = snap_decode(net,buf,size)) != 0 )
+		fprintf(stderr,"%s: not a snapshot\n",file);
+	if( net != *netp ) {
+		if( result == 0 ) {
+			net_free(*netp);
+			*netp = net;
+		} else
+			net_free(net);
+	}
+	free(buf);
+	return result;
+}
@@ -0,0 +1,64 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	timing.c
+ *	Descrioption:	clock cycle count of a board (timing model)
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	"cpuboard.h"
+#include	"timing.h"
+
+
+/*=============================================================================
+ *   Timings
+ *===========================================================================*/
+Timing *
+timing_create(unsigned long hz)
+{
+	Timing	*t;
+
+	if( (t = calloc(1,sizeof(Timing))) == NULL )
+		return NULL;
+	t->hz = hz ? hz : TIMING_HZ;
+	return t;
+}
+
+
+void
+timing_free(Timing *t)
+{
+	free(t);
+}
+
+
+void
+timing_clear(Timing *t)
+{
+	if( t == NULL )
+		return;
+	t->cycles = 0;
+	t->count = 0;
+}
+
+
+/* runtime of the cycles on the board (sec) */
+double
+timing_seconds(const Timing *t, unsigned long long cycles)
+{
+	return (double)cycles / t->hz;
+}
+
+
+void
+timing_report(FILE *fp, const Timing *t)
+{
+	fprintf(fp,"\t%llu cycles, %llu instructions",t->cycles,t->count);
+	if( t->count > 0 )
+		fprintf(fp," (%.2f cycles/instruction)",
+					(double)t->cycles / t->count);
+	fprintf(fp,"\n\t%.6f sec on the board at %lu Hz\n",
+					timing_seconds(t,t->cycles),t->hz);
+}
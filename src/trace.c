@@ -0,0 +1,206 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	trace.c
+ *	Descrioption:	debug trace facility (run-time level control,
+ *			binary trace ring buffer)
+ */
+
+#include	<stdlib.h>
+#include	<string.h>
+#include	"trace.h"
+
+
+/*=============================================================================
+ *   Current Trace Level
+ *===========================================================================*/
+int	trace_level = TRACE_LEVEL_OFF;
+
+static const char	*level_names[] = { "off", "inst", "phase" };
+
+
+/*=============================================================================
+ *   Set the Trace Level by Name ("off", "inst" or "phase")
+ *
+ *   Returns 0 on success, -1 for an unknown name and -2 for a level that
+ *   is not compiled into this build.
+ *===========================================================================*/
+int
+trace_set_level(const char *name)
+{
+	int	level;
+
+	for( level = TRACE_LEVEL_OFF ; level <= TRACE_LEVEL_PHASE ; level++ )
+		if( !strcmp(name,level_names[level]) )
+			break;
+	if( level > TRACE_LEVEL_PHASE )
+		return -1;
+	if( level > CPU_SIM_TRACE_MAX )
+		return -2;
+	trace_level = level;
+	return 0;
+}
+
+
+const char *
+trace_level_name(int level)
+{
+	if( level < TRACE_LEVEL_OFF || level > TRACE_LEVEL_PHASE )
+		return "?";
+	return level_names[level];
+}
+
+
+/*=============================================================================
+ *   Binary Trace Ring Buffer
+ *===========================================================================*/
+#define	TRACE_FILE_MAGIC	"CPUTRC01"
+
+TraceRing *
+trace_ring_create(unsigned long capacity)
+{
+	TraceRing	*ring;
+	unsigned long	size;
+
+	if( capacity > TRACE_RING_MAX )
+		return NULL;
+	for( size = 1 ; size < capacity ; size <<= 1 )
+		;
+	if( (ring = malloc(sizeof(TraceRing))) == NULL )
+		return NULL;
+	if( (ring->rec = calloc(size,sizeof(TraceRecord))) == NULL ) {
+		free(ring);
+		return NULL;
+	}
+	ring->mask = size - 1;
+	ring->head = 0;
+	return ring;
+}
+
+
+void
+trace_ring_free(TraceRing *ring)
+{
+	if( ring != NULL ) {
+		free(ring->rec);
+		free(ring);
+	}
+}
+
+
+/* number of records currently held (oldest ones are overwritten) */
+unsigned long
+trace_ring_count(TraceRing *ring)
+{
+	if( ring->head > ring->mask )
+		return ring->mask + 1;
+	return (unsigned long)ring->head;
+}
+
+
+/* i-th held record, oldest first */
+TraceRecord *
+trace_ring_get(TraceRing *ring, unsigned long i)
+{
+	unsigned long long	first = ring->head - trace_ring_count(ring);
+
+	return &ring->rec[(first + i) & ring->mask];
+}
+
+
+/*
+ *   File format: 8-byte magic, 4-byte little-endian record count,
+ *   followed by the records oldest first.
+ */
+int
+trace_ring_save(TraceRing *ring, const char *file)
+{
+	FILE		*fp;
+	unsigned long	n, i;
+	unsigned char	hdr[12];
+	int		result = 0;
+
+	if( (fp = fopen(file,"wb")) == NULL )
+		return -1;
+	n = trace_ring_count(ring);
+	memcpy(hdr,TRACE_FILE_MAGIC,8);
+	for( i = 0 ; i < 4 ; i++ )
+		hdr[8+i] = (unsigned char)(n >> (8*i));
+	if( fwrite(hdr,1,sizeof(hdr),fp) != sizeof(hdr) )
+		result = -1;
+	for( i = 0 ; i < n && result == 0 ; i++ )
+		if( fwrite(trace_ring_get(ring,i),sizeof(TraceRecord),1,fp) != 1 )
+			result = -1;
+	if( fclose(fp) != 0 )
+		result = -1;
+	return result;
+}
+
+
+TraceRing *
+trace_ring_load(const char *file)
+{
+	FILE		*fp;
+	TraceRing	*ring;
+	unsigned long	n, i;
+	unsigned char	hdr[12];
+
+	if( (fp = fopen(file,"rb")) == NULL )
+		return NULL;
+	if( fread(hdr,1,sizeof(hdr),fp) != sizeof(hdr)
+	    || memcmp(hdr,TRACE_FILE_MAGIC,8) != 0 ) {
+		fclose(fp);
+		return NULL;
+	}
+	for( n = 0, i = 0 ; i < 4 ; i++ )
+		n |= (unsigned long)hdr[8+i] << (8*i);
+	if( n > TRACE_RING_MAX ) {
+		fprintf(stderr,"%s: too many records (%lu, at most %lu)\n",
+						file,n,TRACE_RING_MAX);
+		fclose(fp);
+		return NULL;
+	}
+	if( (ring = trace_ring_create(n ? n : 1)) != NULL ) {
+		ring->head = fread(ring->rec,sizeof(TraceRecord),n,fp);
+	}
+	fclose(fp);
+	return ring;
+}
+
+
+/*=============================================================================
+ *   Render a Record in the DEBUG Format of the Phase Trace
+ *===========================================================================*/
+#define	FLAG(f,bit)	(((f) >> (bit)) & 1)
+
+void
+trace_render(FILE *fp, const TraceRecord *r)
+{
+	const InstructionInfo	*e = &decode_table[r->inst[0]];
+
+	fprintf(fp,"DEBUG: --- Starting new instruction cycle ---\n");
+	fprintf(fp,"DEBUG: Initial PC: 0x%03x\n",r->pc[0]);
+	fprintf(fp,"DEBUG(Phase 1): Fetched PC=0x%03x, Instruction=0x%02x\n",
+		r->pc[0],r->inst[0]);
+	fprintf(fp,"DEBUG: Instruction decoded as Type=%d (A_Field=%d, "
+		"B_Field=%d, AddrModeB=%d)\n",r->type,e->a_field,e->b_field,
+		e->addr_mode_b);
+	if( r->halted ) {
+		fprintf(fp,"DEBUG: Program Halted at 0x%03x.\n",r->pc[0]);
+		return;
+	}
+	if( e->word_length == 2 )
+		fprintf(fp,"DEBUG: Operand fetched. 2nd word=0x%02x, "
+			"Effective Address=0x%03x\n",r->inst[1],
+			r->ea[0] | (r->ea[1] << 8));
+	fprintf(fp,"DEBUG: ACC 0x%02x -> 0x%02x, IX 0x%02x -> 0x%02x\n",
+		r->acc[0],r->acc[1],r->ix[0],r->ix[1]);
+	fprintf(fp,"DEBUG(Flags Update): Final Flags: CF=%d, VF=%d, NF=%d, "
+		"ZF=%d\n",FLAG(r->flags[1],3),FLAG(r->flags[1],2),
+		FLAG(r->flags[1],1),FLAG(r->flags[1],0));
+	fprintf(fp,"DEBUG: Program Counter updated. Current PC: 0x%03x\n",
+		r->pc[1]);
+	fprintf(fp,"DEBUG: --- Instruction cycle completed. Final PC: "
+		"0x%03x ---\n",r->pc[1]);
+}
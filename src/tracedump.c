@@ -0,0 +1,46 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	tracedump.c
+ *	Descrioption:	offline decoder of binary trace files ('trace dump')
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	"cpuboard.h"
+#include	"trace.h"
+
+
+/*=============================================================================
+ *   Main Routine: cpu_sim_tracedump file [count]
+ *
+ *   Renders the records of a trace file in the DEBUG format of the phase
+ *   trace, oldest first.  With a count, only the last count records.
+ *===========================================================================*/
+int
+main(int argc, char *argv[])
+{
+	TraceRing	*ring;
+	unsigned long	n, first, i;
+
+	if( argc < 2 || argc > 3 ) {
+		fprintf(stderr,"usage: %s file [count]\n",argv[0]);
+		return 2;
+	}
+	init_decode_table();
+	if( (ring = trace_ring_load(argv[1])) == NULL ) {
+		fprintf(stderr,"Unable to read trace file %s\n",argv[1]);
+		return 1;
+	}
+
+	n = trace_ring_count(ring);
+	first = 0;
+	if( argc == 3 && strtoul(argv[2],NULL,0) < n )
+		first = n - strtoul(argv[2],NULL,0);
+	for( i = first ; i < n ; i++ )
+		trace_render(stdout,trace_ring_get(ring,i));
+
+	trace_ring_free(ring);
+	return 0;
+}
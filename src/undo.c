@@ -0,0 +1,316 @@
+/*
+ *	Project-based Learning II (CPU)
+ *
+ *	Program:	instruction set simulator of the Educational CPU Board
+ *	File Name:	undo.c
+ *	Descrioption:	undo log of executed instructions (reverse execution)
+ */
+
+#include	<stdlib.h>
+#include	<string.h>
+#include	"cpuboard.h"
+#include	"undo.h"
+
+#define	UNDO_ACC	0x10	/* header bits: what follows the old PC */
+#define	UNDO_IX		0x20
+#define	UNDO_MEM	0x40
+#define	UNDO_PORTS	0x80
+#define	UNDO_RECORD	11	/* longest record */
+#define	UNDO_CHUNK	4096	/* first allocation of a segment */
+
+
+/*=============================================================================
+ *   Logs and Segments
+ *===========================================================================*/
+UndoLog *
+undo_create(size_t limit)
+{
+	UndoLog	*log;
+
+	if( (log = calloc(1,sizeof(UndoLog))) == NULL )
+		return NULL;
+	log->limit = limit;
+	log->st_addr = -1;
+	return log;
+}
+
+
+static void
+drop_segment(UndoLog *log, UndoSeg *seg)
+{
+	if( seg->prev != NULL )
+		seg->prev->next = seg->next;
+	else
+		log->first = seg->next;
+	if( seg->next != NULL )
+		seg->next->prev = seg->prev;
+	else
+		log->last = seg->prev;
+	log->n -= seg->n;
+	log->size -= sizeof(UndoSeg) + seg->size;
+	free(seg->bytes);
+	free(seg);
+}
+
+
+void
+undo_clear(UndoLog *log)
+{
+	if( log == NULL )
+		return;
+	while( log->last != NULL )
+		drop_segment(log,log->last);
+}
+
+
+void
+undo_free(UndoLog *log)
+{
+	undo_clear(log);
+	free(log);
+}
+
+
+/*=============================================================================
+ *   Registers and Marks
+ *===========================================================================*/
+static void
+get_regs(Cpub *cpub, UndoRegs *r)
+{
+	r->pc = cpub->pc;
+	r->acc = cpub->acc;
+	r->ix = cpub->ix;
+	r->flags = (cpub->cf << 3) | (cpub->vf << 2) | (cpub->nf << 1)
+							| cpub->zf;
+	r->iflag = r->ibuf = 0;
+	if( cpub->ibuf != NULL ) {
+		r->iflag = cpub->ibuf->flag;
+		r->ibuf = cpub->ibuf->buf;
+	}
+	r->oflag = cpub->obuf.flag;
+	r->obuf = cpub->obuf.buf;
+}
+
+static void
+set_flags(Cpub *cpub, Uword flags)
+{
+	cpub->cf = (flags >> 3) & 1;
+	cpub->vf = (flags >> 2) & 1;
+	cpub->nf = (flags >> 1) & 1;
+	cpub->zf = flags & 1;
+	cpub->flag_op = FLAGS_VALID;
+}
+
+static void
+set_ports(Cpub *cpub, Uword iflag, Uword ibuf, Uword oflag, Uword obuf)
+{
+	if( cpub->ibuf != NULL ) {
+		cpub->ibuf->flag = iflag;
+		cpub->ibuf->buf = ibuf;
+	}
+	cpub->obuf.flag = oflag;
+	cpub->obuf.buf = obuf;
+}
+
+static void
+set_mem(Cpub *cpub, int addr, Uword value)
+{
+	if( cpub->mem[addr] != value ) {
+		cpub->mem[addr] = value;
+		CodeWrite(cpub,addr);
+	}
+}
+
+/* put the board back to the mark of a segment */
+static void
+restore_mark(Cpub *cpub, const UndoMark *m)
+{
+	int	addr;
+
+	cpub->pc = m->r.pc;
+	cpub->acc = m->r.acc;
+	cpub->ix = m->r.ix;
+	set_flags(cpub,m->r.flags);
+	set_ports(cpub,m->r.iflag,m->r.ibuf,m->r.oflag,m->r.obuf);
+	for( addr = 0 ; addr < IMEMORY_SIZE ; addr++ )
+		set_mem(cpub,addr,m->mem[addr]);
+	memcpy(cpub->mem + IMEMORY_SIZE,m->mem + IMEMORY_SIZE,
+					MEMORY_SIZE - IMEMORY_SIZE);
+}
+
+
+/*=============================================================================
+ *   Recording (by step())
+ *
+ *   undo_begin() before the instruction, undo_store(addr) before an ST
+ *   and undo_end() once it has completed
+ *===========================================================================*/
+void
+undo_begin(Cpub *cpub)
+{
+	UndoLog	*log = cpub->undo;
+
+	FlagSync(cpub);
+	get_regs(cpub,&log->pend);
+	log->st_addr = -1;
+}
+
+
+void
+undo_store(Cpub *cpub, Addr addr)
+{
+	cpub->undo->st_addr = addr;
+	cpub->undo->st_old = cpub->mem[addr];
+}
+
+
+/* a segment with room for a record (NULL: out of memory) */
+static UndoSeg *
+undo_room(Cpub *cpub)
+{
+	UndoLog	*log = cpub->undo;
+	UndoSeg	*seg = log->last;
+	Uword	*p;
+	size_t	size;
+
+	if( seg == NULL || seg->n == UNDO_SEGMENT ) {
+		if( (seg = calloc(1,sizeof(UndoSeg))) == NULL )
+			return NULL;
+		seg->mark.r = log->pend;
+		memcpy(seg->mark.mem,cpub->mem,MEMORY_SIZE);
+		if( log->st_addr >= 0 )
+			seg->mark.mem[log->st_addr] = log->st_old;
+		seg->prev = log->last;
+		if( log->last != NULL )
+			log->last->next = seg;
+		else
+			log->first = seg;
+		log->last = seg;
+		log->size += sizeof(UndoSeg);
+	}
+	if( seg->len + UNDO_RECORD > seg->size ) {
+		size = seg->size ? 2 * seg->size : UNDO_CHUNK;
+		if( (p = realloc(seg->bytes,size)) == NULL )
+			return NULL;
+		log->size += size - seg->size;
+		seg->bytes = p;
+		seg->size = size;
+	}
+	return seg;
+}
+
+void
+undo_end(Cpub *cpub)
+{
+	UndoLog		*log = cpub->undo;
+	UndoRegs	now;
+	UndoSeg		*seg;
+	Uword		*p, hdr;
+
+	if( (seg = undo_room(cpub)) == NULL ) {
+		undo_clear(log);	/* a gap would undo wrongly */
+		return;
+	}
+	get_regs(cpub,&now);
+	p = seg->bytes + seg->len;
+	hdr = log->pend.flags;
+	if( log->st_addr >= 0 ) {
+		*p++ = log->st_addr & 0xff;
+		*p++ = log->st_addr >> 8;
+		*p++ = log->st_old;
+		hdr |= UNDO_MEM;
+	}
+	if( now.iflag != log->pend.iflag || now.ibuf != log->pend.ibuf
+	 || now.oflag != log->pend.oflag || now.obuf != log->pend.obuf ) {
+		*p++ = (log->pend.iflag << 1) | log->pend.oflag;
+		*p++ = log->pend.ibuf;
+		*p++ = log->pend.obuf;
+		hdr |= UNDO_PORTS;
+	}
+	if( now.ix != log->pend.ix ) {
+		*p++ = log->pend.ix;
+		hdr |= UNDO_IX;
+	}
+	if( now.acc != log->pend.acc ) {
+		*p++ = log->pend.acc;
+		hdr |= UNDO_ACC;
+	}
+	*p++ = log->pend.pc;
+	*p++ = hdr;
+	seg->len = p - seg->bytes;
+	seg->n++;
+	log->n++;
+
+	while( log->size > log->limit && log->first != log->last )
+		drop_segment(log,log->first);
+}
+
+
+/*=============================================================================
+ *   Going Back
+ *===========================================================================*/
+/*
+ *   Undo the last instruction; *stored is the address it stored to (-1:
+ *   none).  -1 if the log is empty.
+ */
+int
+undo_back(Cpub *cpub, int *stored)
+{
+	UndoLog	*log = cpub->undo;
+	UndoSeg	*seg;
+	Uword	*p, hdr, fl, ibuf, obuf;
+	int	addr;
+
+	*stored = -1;
+	if( log == NULL || (seg = log->last) == NULL )
+		return -1;
+	p = seg->bytes + seg->len;
+	hdr = *--p;
+	cpub->pc = *--p;
+	set_flags(cpub,hdr & 0x0f);
+	if( hdr & UNDO_ACC )
+		cpub->acc = *--p;
+	if( hdr & UNDO_IX )
+		cpub->ix = *--p;
+	if( hdr & UNDO_PORTS ) {
+		obuf = *--p;
+		ibuf = *--p;
+		fl = *--p;
+		set_ports(cpub,(fl >> 1) & 1,ibuf,fl & 1,obuf);
+	}
+	if( hdr & UNDO_MEM ) {
+		p -= 3;
+		addr = p[0] | (p[1] << 8);
+		set_mem(cpub,addr,p[2]);
+		*stored = addr;
+	}
+	seg->len = p - seg->bytes;
+	seg->n--;
+	log->n--;
+	if( seg->n == 0 )
+		drop_segment(log,seg);
+	return 0;
+}
+
+
+/*
+ *   Undo up to n instructions, whole segments at a time while they fit;
+ *   returns how many were undone
+ */
+unsigned long long
+undo_seek(Cpub *cpub, unsigned long long n)
+{
+	UndoLog			*log = cpub->undo;
+	unsigned long long	done = 0;
+	int			stored;
+
+	while( done < n && log != NULL && log->last != NULL ) {
+		if( n - done >= log->last->n ) {
+			restore_mark(cpub,&log->last->mark);
+			done += log->last->n;
+			drop_segment(log,log->last);
+		} else if( undo_back(cpub,&stored) == 0 )
+			done++;
+	}
+	return done;
+}